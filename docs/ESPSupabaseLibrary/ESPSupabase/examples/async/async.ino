@@ -0,0 +1,71 @@
+#include <Arduino.h>
+#include <ESPSupabase.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+Supabase db;
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "ssid";
+const char *psswd = "pass";
+
+unsigned long lastRequest = 0;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Serial.print("Connecting to WiFi");
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  // Beginning Supabase Connection
+  db.begin(supabase_url, anon_key);
+  db.setKeepAlive(true);
+  // requests queued in the same tick share one round trip
+  db.setPipeline(3);
+}
+
+void loop()
+{
+  if (millis() - lastRequest > 10000)
+  {
+    lastRequest = millis();
+
+    // returns immediately, the callback runs from poll() once the response is in
+    db.from("examples").select("*").limit(1).submitSelect([](int code, String &body)
+    {
+      Serial.println(code);
+      Serial.println(body);
+    });
+
+    db.update("examples").eq("id", "1").submitUpdate("{\"seen\": true}", [](int code, String &body)
+    {
+      Serial.printf("update: %d\n", code);
+    });
+
+    // a POST is queued last, nothing is pipelined behind it
+    db.submitInsert("examples", "{\"value\": 1}", [](int code, String &body)
+    {
+      Serial.printf("insert: %d\n", code);
+    });
+  }
+
+  // advances the request for at most a few milliseconds
+  db.poll();
+
+  // the rest of your loop keeps running while the request is in flight
+}
@@ -0,0 +1,72 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPSupabase.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+Supabase db;
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "ssid";
+const char *psswd = "pass";
+
+// Put your target table here
+String table = "";
+
+unsigned long lastSample = 0;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Serial.print("Connecting to WiFi");
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  // Beginning Supabase Connection
+  db.begin(supabase_url, anon_key);
+
+  // Uncomment this line below, if you activate RLS in your Supabase Table
+  // db.login_email("email", "password");
+
+  // Send the rows as one request every 10 rows, or at least once a minute
+  // Every row of a batch must have the same columns
+  db.beginBatch(table, 10, 60000);
+}
+
+void loop()
+{
+  if (millis() - lastSample > 5000)
+  {
+    lastSample = millis();
+
+    JsonDocument doc;
+    doc["value"] = analogRead(A0);
+
+    String row;
+    serializeJson(doc, row);
+
+    // returns 0 while the row is only buffered
+    int code = db.insertBatch(row);
+    if (code != 0)
+    {
+      Serial.println(code);
+    }
+  }
+
+  // flushes rows that waited longer than the time limit
+  db.checkBatch();
+}
@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPSupabaseRealtime.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "ssid";
+const char *psswd = "pass";
+
+String device_id = "device-1";
+
+SupabaseRealtime realtime;
+
+// Both channels share the one WebSocket of realtime
+SupabaseRealtimeChannel commands("device:" + device_id);
+SupabaseRealtimeChannel fleet("fleet");
+
+void HandleCommand(const SupabaseChange &change)
+{
+  const char *command = change.record["command"];
+  Serial.print("command: ");
+  Serial.println(command);
+}
+
+void HandleFleet(const char *event, JsonObjectConst payload)
+{
+  Serial.print("fleet ");
+  Serial.print(event);
+  Serial.print(": ");
+  serializeJson(payload, Serial);
+  Serial.println();
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  realtime.begin(supabase_url, anon_key, nullptr);
+
+  // Uncomment this line below, if you activate RLS in your Supabase Table
+  // realtime.login_email("email", "password");
+
+  // The commands of this device only
+  commands.addChangesListener("device_commands", "INSERT", "public", "device_id=eq." + device_id, HandleCommand);
+  commands.sendPresence(device_id);
+  realtime.join(commands);
+
+  // Messages broadcast to every device
+  fleet.onBroadcast(HandleFleet);
+  realtime.join(fleet);
+
+  realtime.listen();
+}
+
+void loop()
+{
+  realtime.loop();
+
+  // e.g. report back to the fleet channel once joined
+  static unsigned long last = 0;
+  if (fleet.joined() && millis() - last > 60000)
+  {
+    last = millis();
+    fleet.broadcast("status", "{\"device\":\"" + device_id + "\",\"online\":true}");
+  }
+}
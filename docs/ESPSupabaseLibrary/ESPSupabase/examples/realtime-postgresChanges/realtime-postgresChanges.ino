@@ -18,20 +18,22 @@ const char *psswd = "pass";
 
 SupabaseRealtime realtime;
 
-void HandleChanges(String result)
+void HandleChanges(const SupabaseChange &change)
 {
-  JsonDocument doc;
-  deserializeJson(doc, result);
-
   // EXAMPLE of what you can do with the result
-  String tableName = doc["table"];
-  String event = doc["type"];
-  String changes = doc["record"];
-
-  Serial.print(tableName);
+  Serial.print(change.table);
   Serial.print(" : ");
-  Serial.println(event);
-  Serial.println(changes);
+  Serial.println(change.type);
+  serializeJson(change.record, Serial);
+  Serial.println();
+}
+
+// Only gets the INSERTs of table1
+void HandleTable1Insert(const SupabaseChange &change)
+{
+  Serial.print("table1 new row: ");
+  serializeJson(change.record, Serial);
+  Serial.println();
 }
 
 void setup()
@@ -46,7 +48,10 @@ void setup()
   }
   Serial.println("\nConnected!");
 
-  realtime.begin(supabase_url, anon_key, HandleChanges);
+  // The typed handler reads the event straight from the parsed message,
+  // a void HandleChanges(String result) can be given to begin() instead
+  realtime.begin(supabase_url, anon_key, nullptr);
+  realtime.onChange(HandleChanges);
 
   // Uncomment this line below, if you activate RLS in your Supabase Table
   // realtime.login_email("email", "password");
@@ -61,8 +66,9 @@ void setup()
   //   Please read : https://supabase.com/docs/guides/realtime/postgres-changes?queryGroups=language&language=js#available-filters
   //   empty string if you don't want to filter the result
   // EXAMPLE :
-  realtime.addChangesListener("table1", "INSERT", "public", "id=eq.0");
-  // You can add multiple table listeners
+  realtime.addChangesListener("table1", "INSERT", "public", "id=eq.0", HandleTable1Insert);
+  // You can add multiple table listeners, the ones without a handler of
+  // their own go to the handler of onChange() (or begin())
   realtime.addChangesListener("table2", "*", "public", "");
 
   realtime.listen();
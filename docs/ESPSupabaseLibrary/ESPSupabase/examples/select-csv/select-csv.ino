@@ -0,0 +1,56 @@
+#include <Arduino.h>
+#include <ESPSupabase.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+Supabase db;
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "ssid";
+const char *psswd = "pass";
+
+// Holds the header row and one result row at a time
+char csvBuffer[256];
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Serial.print("Connecting to WiFi");
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  // Beginning Supabase Connection
+  db.begin(supabase_url, anon_key);
+
+  // The result comes as CSV, much smaller than JSON with its repeated keys,
+  // and every row is split in place in csvBuffer without any allocation
+  int code = db.from("co_readings").select("created_at,co_level,status").order("created_at", "desc", true).limit(50).doSelectCsv([](const SupabaseCsvRow &row)
+  {
+    // columns in the order of the select
+    Serial.print(row.text(0));
+    Serial.print(" : ");
+    Serial.print(row.toDouble(1));
+    Serial.print(" ppm, ");
+    Serial.println(row.text(2));
+  }, csvBuffer, sizeof(csvBuffer));
+  Serial.println(code);
+}
+
+void loop()
+{
+  delay(1000);
+}
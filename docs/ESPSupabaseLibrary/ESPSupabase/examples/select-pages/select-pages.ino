@@ -0,0 +1,72 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPSupabase.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+Supabase db;
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "ssid";
+const char *psswd = "pass";
+
+// The session to walk through
+String session_id = "";
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Serial.print("Connecting to WiFi");
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  // Beginning Supabase Connection
+  db.begin(supabase_url, anon_key);
+  db.setKeepAlive(true);
+
+  JsonDocument filter;
+  filter["co_level"] = true;
+
+  // Every page asks for the rows after the last id seen (id=gt.<last>), so
+  // page 100 is as fast as page 1 and only one row is in memory at a time
+  SupabaseCursor readings = db.from("co_readings").select("id,co_level").eq("session_id", session_id).cursor("id", 200);
+
+  float peak = 0;
+  unsigned long rows = 0;
+  while (!readings.done())
+  {
+    int code = readings.next([&](JsonObjectConst row)
+    {
+      peak = max(peak, row["co_level"].as<float>());
+      rows++;
+    }, &filter);
+
+    if (code != 200)
+    {
+      // resume later from readings.lastKey()
+      Serial.printf("Page failed with code %d\n", code);
+      break;
+    }
+  }
+
+  Serial.printf("%lu readings, peak %.1f ppm\n", rows, peak);
+}
+
+void loop()
+{
+  delay(1000);
+}
@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPSupabase.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+Supabase db;
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "ssid";
+const char *psswd = "pass";
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Serial.print("Connecting to WiFi");
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  // Beginning Supabase Connection
+  db.begin(supabase_url, anon_key);
+
+  // Only keep the fields you need, everything else is skipped while parsing
+  JsonDocument filter;
+  filter["co_level"] = true;
+  filter["created_at"] = true;
+
+  // Rows are parsed one at a time straight from the connection,
+  // the response body is never kept in memory
+  int code = db.from("co_readings").select("*").order("created_at", "desc", true).limit(50).doSelectEach([](JsonObjectConst row)
+  {
+    Serial.print(row["created_at"].as<const char *>());
+    Serial.print(" : ");
+    Serial.println(row["co_level"].as<float>());
+  }, &filter);
+  Serial.println(code);
+
+  // Or parse the whole (filtered) result into one document
+  JsonDocument doc;
+  code = db.from("co_readings").select("co_level").limit(10).doSelect(doc, &filter);
+  Serial.println(code);
+  Serial.println(doc.size());
+}
+
+void loop()
+{
+  delay(1000);
+}
@@ -0,0 +1,88 @@
+#include <ESPSupabase.h>
+#include "SPIFFS.h"
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+Supabase db;
+
+// Put your supabase URL and Anon key here...
+String supabase_url = "https://yourproject.supabase.co";
+String anon_key = "anonkey";
+
+// put your WiFi credentials (SSID and Password) here
+const char *ssid = "";
+const char *psswd = "";
+
+// Put Supabase account credentials here
+const String email = "";
+const String password = "";
+
+// Supabase Storage Bucket name here
+const String bucket = "";
+
+// A large file, e.g. a log archive
+const String fileToUpload = "/log.txt";
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("");
+
+  if (!SPIFFS.begin(true))
+  {
+    Serial.println("Error occurred when starting SPIFFS module.");
+    return;
+  }
+
+  File file = SPIFFS.open(fileToUpload);
+
+  if (!file)
+  {
+    Serial.println("Error when opening file.");
+    return;
+  }
+
+  Serial.print("Connecting to WiFi");
+
+  WiFi.begin(ssid, psswd);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+    Serial.print(".");
+  }
+  Serial.println("\nConnected!");
+
+  db.begin(supabase_url, anon_key);
+  db.setKeepAlive(true);
+
+  static uint8_t uploadBuffer[2048];
+  db.setUploadBuffer(uploadBuffer, sizeof(uploadBuffer));
+
+  // Uncomment this line below, if you activate RLS in your Supabase Table
+  // db.login_email(email, password);
+
+  // If the connection drops the upload continues where the server left off.
+  // If the board reboots, calling this again with the same file continues from
+  // the upload url saved in /supabase-upload.tus.
+  int uploadResponse = db.uploadResumable(bucket, "log.txt", "text/plain", file, SPIFFS);
+
+  if (uploadResponse == 204)
+  {
+    Serial.println("File succesfully uploaded!");
+  }
+  else
+  {
+    Serial.printf("File upload failed with code: %d.\n\r", uploadResponse);
+  }
+
+  file.close();
+}
+
+void loop()
+{
+  delay(1000);
+}
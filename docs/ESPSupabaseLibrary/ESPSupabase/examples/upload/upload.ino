@@ -78,6 +78,10 @@ void setup()
 
   db.begin(supabase_url, anon_key);
 
+  // A larger buffer sends the file in bigger pieces
+  static uint8_t uploadBuffer[2048];
+  db.setUploadBuffer(uploadBuffer, sizeof(uploadBuffer));
+
   // Uncomment this line below, if you activate RLS in your Supabase Table
   // int loginResponse = db.login_email(email, password);
 
@@ -95,6 +99,8 @@ void setup()
   if (uploadResponse == 200)
   {
     Serial.println("File succesfully created!");
+    SupabaseUploadStats stats = db.getUploadStats();
+    Serial.printf("%u bytes in %lu ms (%u B/s)\n\r", stats.bytes, stats.duration, stats.bytesPerSecond);
   }
   else
   {
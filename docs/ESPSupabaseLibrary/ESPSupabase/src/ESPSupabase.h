@@ -4,6 +4,18 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WiFiClientSecure.h>
+#include <FS.h>
+#include "SupabaseQuery.h"
+#include "SupabaseStream.h"
+#include "SupabaseRetry.h"
+#include "SupabaseAuth.h"
+#include "SupabaseUpload.h"
+#include "SupabasePrepared.h"
+#include "SupabaseInflate.h"
+#include "SupabaseCsv.h"
+#include "SupabaseWriteOptions.h"
+#include "SupabaseMetrics.h"
+#include "SupabaseHeap.h"
 
 #if defined(ESP8266)
 #include <ESP8266HTTPClient.h>
@@ -13,10 +25,53 @@
 #error "This library is not supported for your board! ESP32 and ESP8266"
 #endif
 
+// Called once per row by the streaming select/rpc, the row is only valid
+// during the call
+typedef std::function<void(JsonObjectConst row)> SupabaseRowCallback;
+typedef std::function<void(const SupabaseCsvRow &row)> SupabaseCsvCallback;
+
+// Called when a request submitted with submit() completes. httpCode is
+// negative when the request failed before a response was received.
+typedef std::function<void(int httpCode, String &body)> SupabaseResponseCallback;
+
+#ifndef SUPABASE_ASYNC_QUEUE
+#define SUPABASE_ASYNC_QUEUE 4
+#endif
+
+// most bytes a batch buffers while it can't be sent, rows beyond are rejected
+#ifndef SUPABASE_BATCH_MAX_BYTES
+#define SUPABASE_BATCH_MAX_BYTES 8192
+#endif
+
+struct SupabaseAsyncRequest
+{
+  const char *method;
+  String path;
+  String payload;
+  String prefer;
+  SupabaseResponseCallback onDone;
+  uint8_t attempts;
+  bool lost; // pipelined POST whose connection broke before its response
+};
+
+struct SupabaseConnectionStats
+{
+  uint32_t opened = 0;     // requests that had to open a new TLS connection
+  uint32_t reused = 0;     // requests served on an already open connection
+  uint32_t reconnects = 0; // stale kept-alive connections transparently reopened
+  uint32_t idleCloses = 0; // connections closed after keepAliveIdleTimeout
+  uint32_t pipelined = 0;  // requests written before the previous response arrived
+};
+
+class SupabaseCursor;
+
 class Supabase
 {
 private:
+  friend class SupabaseCursor;
+
   String hostname;
+  String host;
   String key;
 
   String url_query;
@@ -31,9 +86,136 @@ private:
   String filter;
 
   void _check_last_string();
+  int _token_request(const char *grant, const String &body);
   int _login_process();
-  unsigned int authTimeout = 0;
-  unsigned long loginTime;
+  int _refresh_process();
+  int _renew();
+  int _login_retry();
+  void _check_auth();
+  SupabaseSession session;
+  bool asyncRenewing = false;
+  unsigned long asyncRenewAt = 0;
+  uint8_t renewAttempts = 0;
+  void _asyncRenew();
+  bool _asyncRenewFirst();
+  bool _asyncGrant(bool first);
+
+  // Connection manager
+  bool keepAlive = false;
+  unsigned long keepAliveIdleTimeout = 30000;
+  unsigned long lastActivity = 0;
+  SupabaseConnectionStats connectionStats;
+
+  // Retry policy, defaultRetryPolicy unless one is shared with setRetryPolicy()
+  SupabaseRetryPolicy defaultRetryPolicy;
+  SupabaseRetryPolicy *retryPolicy = nullptr;
+  SupabaseRetryPolicy &_retry();
+
+  // Request timings, recorded only when setMetrics() was given one. The
+  // request in flight is timed here, the async engine's apart
+  SupabaseMetrics *metrics = nullptr;
+  SupabaseRequestTimer requestTimer;
+  SupabaseRequestTimer asyncTimer;
+
+  bool _begin(const String &url);
+  int _send(const char *method, const String &payload);
+  void _end(bool discardBody = false);
+  int _open(const char *method, const String &url, const String &payload, const String &prefer, const char *accept = nullptr);
+  bool _isChunked();
+  int _parse(const char *method, const String &url, const String &payload, JsonDocument &doc, JsonDocument *filter);
+  int _parseEach(const char *method, const String &url, const String &payload, SupabaseRowCallback onRow, JsonDocument *filter);
+  String _doSelect(const String &url);
+  int _selectCsv(const String &url, SupabaseCsvCallback onRow, char *buffer, size_t size);
+  int _head(const String &path, const String &method, long *count);
+
+  // Non-blocking request engine
+  enum AsyncState
+  {
+    ASYNC_IDLE,
+    ASYNC_RESOLVE,
+    ASYNC_CONNECT,
+    ASYNC_SEND,
+    ASYNC_STATUS,
+    ASYNC_HEADERS,
+    ASYNC_BODY
+  };
+  SupabaseAsyncRequest asyncQueue[SUPABASE_ASYNC_QUEUE];
+  uint8_t asyncHead = 0;
+  uint8_t asyncCount = 0;
+  AsyncState asyncState = ASYNC_IDLE;
+  unsigned long asyncBudget = 5;
+  unsigned long asyncTimeout = 10000;
+  unsigned long asyncSince = 0;
+  unsigned long asyncRetryAt = 0;
+  String asyncOut;
+  size_t asyncOutSent = 0;
+  uint8_t asyncSent = 0; // requests from the head written and waiting for their response
+  uint8_t asyncDepth = 1;
+  bool asyncReused = false;
+  String asyncLine;
+  int asyncCode = 0;
+  int asyncLength = -1;
+  bool asyncChunked = false;
+  bool asyncClose = false;
+  String asyncBody;
+  SupabaseBodyStream asyncBodyStream;
+  IPAddress asyncIp;
+  bool _asyncQueue(bool first, const char *method, const String &path, const String &payload, SupabaseResponseCallback onDone, const String &prefer);
+  bool _asyncStep();
+  void _asyncStart();
+  void _asyncSerialize(SupabaseAsyncRequest &request);
+  bool _asyncPipelineNext();
+  void _asyncExpect();
+  void _asyncRewind(uint8_t count, bool unprocessed);
+  void _asyncNextResponse(uint8_t followers);
+  bool _asyncReadHead();
+  void _asyncHeader(String &line);
+  bool _asyncRetry();
+  void _asyncFinish(int httpCode);
+  int _doUpdate(const String &url, const String &json);
+  int _write(const char *method, String url, const String &json, const SupabaseWriteOptions &options, String *response);
+
+  // Requests written by hand on the connection (uploads)
+  uint8_t *uploadBuffer = nullptr;
+  size_t uploadBufferSize = 0;
+  SupabaseUploadStats uploadStats;
+  bool _rawConnect(bool *reused = nullptr);
+  int _rawResponse(SupabaseBodyStream &body, bool &close, bool head = false, const char *const *keys = nullptr, String *values = nullptr, uint8_t count = 0);
+  void _rawEnd(bool close);
+  int _upload(String bucket, String filename, String mime_type, const uint8_t *data, Stream *stream, uint32_t size);
+
+  // Resumable (TUS) uploads
+  uint32_t tusChunk = 6 * 1024 * 1024;
+  String _tusHeaders(const char *method, const String &path);
+  int _tusRequest(const String &header, bool head, const char *const *keys, String *values, uint8_t count);
+  int _tusCreate(String bucket, String filename, String mime_type, uint32_t size, String &location);
+  int _tusOffset(const String &location, uint32_t &offset);
+  int _tusPatch(const String &location, fs::File &file, uint32_t &offset, uint32_t length);
+
+  int _executeOpen(SupabasePrepared &request, const String &payload, const char *params, SupabaseBodyStream &body, bool &close, const char *const *keys = nullptr, String *values = nullptr, uint8_t count = 0);
+
+  // Response bodies, decompressed when setCompression() is on
+  bool acceptGzip = false;
+  bool bodyRaw = false;
+  bool bodyClose = false;
+  int _openBody(const char *method, const String &url, const String &payload, SupabaseBodyStream &body, bool &gzip, const char *accept = nullptr, const String &prefer = "");
+  void _closeBody(SupabaseBodyStream &body);
+  // only holds memory while a gzip response is read
+  SupabaseInflateStream inflate;
+  bool _inflate(SupabaseBodyStream &body);
+  Stream &_decoded(SupabaseBodyStream &body, bool gzip);
+
+  // Batched insert
+  String batchTable;
+  String batchBody;
+  SupabaseWriteOptions batchOptions;
+  uint16_t batchRows = 0;
+  uint16_t batchMaxRows = 10;
+  unsigned long batchMaxAge = 60000;
+  unsigned long batchStarted = 0;
+  unsigned long batchRetryAt = 0;
+  uint8_t batchFailures = 0;
+  bool _batchBackingOff();
 
 public:
   bool useAuth;
@@ -45,16 +227,59 @@ public:
   void setupRealtime(String hostname_a, String key_a);
   void begin(String hostname_a, String key_a);
   String getQuery();
+
+  // keep one TLS connection open across calls (HTTP/1.1 keep-alive)
+  void setKeepAlive(bool enable, unsigned long idleTimeout = 30000);
+  // asks for gzip compressed selects and rpc results, needs 32 KB of free heap
+  // while a compressed response is read
+  void setCompression(bool gzip);
+  void disconnect();
+  SupabaseConnectionStats getConnectionStats();
+
+  // bounded retries with backoff, pass nullptr to go back to the default policy
+  void setRetryPolicy(SupabaseRetryPolicy *policy);
+  // records the timings of every request in metrics (can be shared between
+  // clients), nullptr turns it off
+  void setMetrics(SupabaseMetrics *metrics_a);
+
   // query reset
   void urlQuery_reset();
 
   // membuat Query Builder
   Supabase &from(String table);
   int insert(String table, String json, bool upsert);
+  // insert shaped by options (Prefer return/missing/resolution, columns),
+  // the response body goes to response if given
+  int insert(String table, String json, const SupabaseWriteOptions &options, String *response = nullptr);
   Supabase &select(String colls);
   Supabase &update(String table);
+
+  // Batched insert, rows are sent together as one JSON array
+  void beginBatch(String table, uint16_t maxRows, unsigned long maxAge, bool upsert = false);
+  void beginBatch(String table, uint16_t maxRows, unsigned long maxAge, const SupabaseWriteOptions &options);
+  int insertBatch(String json);
+  int flushBatch();
+  int checkBatch();
+  uint16_t batchCount();
+
   int upload(String bucket, String filename, String mime_type, Stream *stream, uint32_t size);
   int upload(String bucket, String filename, String mime_type, uint8_t *buffer, uint32_t size);
+  // reusable buffer for upload(), 1-4 KB lets the body leave in full TLS records
+  void setUploadBuffer(uint8_t *buffer, size_t size);
+  SupabaseUploadStats getUploadStats();
+  // Uploads file with the TUS protocol. After a dropped connection it continues
+  // from the offset the server has, the upload url is kept in statePath on
+  // stateFs so a call after a reboot continues too. Returns 204 when done.
+  int uploadResumable(String bucket, String filename, String mime_type, fs::File &file, fs::FS &stateFs, String statePath = "/supabase-upload.tus");
+  // bytes per PATCH request, Supabase Storage expects 6 MB (the default)
+  void setResumableChunk(uint32_t size);
+
+  // Prepared requests, see SupabasePrepared. path starts at /rest/v1/...
+  SupabasePrepared prepare(const char *method, const String &path, const String &prefer = "", const String &accept = "");
+  SupabasePrepared prepare(const char *method, const SupabaseQuery &query, const String &prefer = "", const String &accept = "");
+  // params is appended to the prepared path (e.g. the value of a trailing filter)
+  int execute(SupabasePrepared &request, const String &payload = "", String *response = nullptr, const char *params = nullptr);
+  int execute(SupabasePrepared &request, JsonDocument &doc, JsonDocument *filter = nullptr, const char *params = nullptr);
 
   // Comparison Operator
   Supabase &eq(String coll, String conditions);
@@ -81,14 +306,81 @@ public:
 
   // do select. execute this after building your query
   String doSelect();
+  String doSelect(const SupabaseQuery &query);
+  // streaming select, parses straight from the connection without
+  // keeping the response body in memory
+  int doSelect(JsonDocument &doc, JsonDocument *filter = nullptr);
+  int doSelectEach(SupabaseRowCallback onRow, JsonDocument *filter = nullptr);
+  // compact select: the result comes as CSV and onRow gets typed columns,
+  // split in place in buffer (which must hold the header and the longest row)
+  int doSelectCsv(SupabaseCsvCallback onRow, char *buffer, size_t size);
+  int doSelectCsv(const SupabaseQuery &query, SupabaseCsvCallback onRow, char *buffer, size_t size);
+  // header-only select (HEAD): a cheap existence or reachability check
+  int doHead();
+  int doHead(const SupabaseQuery &query);
+  // number of matching rows without downloading them, method is "exact",
+  // "planned" or "estimated". count is -1 if the server didn't report it.
+  int doCount(long &count, String method = "exact");
+  int doCount(const SupabaseQuery &query, long &count, String method = "exact");
 
   // do update. execute this after querying your update
   int doUpdate(String json);
+  int doUpdate(const SupabaseQuery &query, String json);
+  int doUpdate(String json, const SupabaseWriteOptions &options, String *response = nullptr);
+  int doUpdate(const SupabaseQuery &query, String json, const SupabaseWriteOptions &options, String *response = nullptr);
 
   int login_email(String email_a, String password_a);
   int login_phone(String phone_a, String password_a);
 
+  // Non-blocking requests. They are queued and advanced a few milliseconds
+  // at a time by poll(), which must be called from loop().
+  // Don't call the blocking methods while busy() is true, both share the connection.
+  bool submit(const char *method, String path, String payload, SupabaseResponseCallback onDone, String prefer = "");
+  bool submitSelect(SupabaseResponseCallback onDone);
+  bool submitInsert(String table, String json, SupabaseResponseCallback onDone);
+  bool submitUpdate(String json, SupabaseResponseCallback onDone);
+  bool submitRpc(String func_name, String json_param, SupabaseResponseCallback onDone);
+  void poll();
+  bool busy();
+  void setPollBudget(unsigned long budget, unsigned long timeout = 10000);
+  // writes up to depth queued requests back-to-back on the kept-alive
+  // connection before reading their responses (HTTP/1.1 pipelining), 1 is off
+  void setPipeline(uint8_t depth);
+
   String rpc(String func_name, String json_param = "");
+  int rpc(String func_name, String json_param, JsonDocument &doc, JsonDocument *filter = nullptr);
+  int rpcEach(String func_name, String json_param, SupabaseRowCallback onRow, JsonDocument *filter = nullptr);
+
+  // Keyset paging over the select built so far, see SupabaseCursor
+  SupabaseCursor cursor(String key, uint16_t pageSize = 100);
+  SupabaseCursor cursor(const SupabaseQuery &query, String key, uint16_t pageSize = 100);
+};
+
+// Pages through a select by a unique, increasing key (e.g. id): every page
+// asks for key=gt.<last key seen>, ordered by key, so each page costs the same
+// however deep into the table it is, unlike offset(). Rows are streamed one at
+// a time, memory stays constant.
+class SupabaseCursor
+{
+private:
+  friend class Supabase;
+  Supabase &db;
+  String query; // table?filters, without order and limit
+  String key;
+  String last;
+  uint16_t pageSize;
+  bool end = false;
+
+  SupabaseCursor(Supabase &db_a, const String &query_a, const String &key_a, uint16_t pageSize_a);
+
+public:
+  // fetches the next page, calling onRow for every row. Returns http response code.
+  int next(SupabaseRowCallback onRow, JsonDocument *filter = nullptr);
+  // true once a page came back short
+  bool done();
+  // key of the last row seen, save it to continue later with resume()
+  String lastKey();
+  void resume(String lastKey);
 };
 
 #endif
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <ArduinoJson.h>
 #include <WiFiClientSecure.h>
 #include <WebSocketsClient.h>
+#include "SupabaseRetry.h"
+#include "SupabaseAuth.h"
+#include "SupabaseHeap.h"
 
 #if defined(ESP8266)
 #include <ESP8266HTTPClient.h>
@@ -14,9 +17,123 @@
 #error "This library is not supported for your board! ESP32 and ESP8266"
 #endif
 
+// One postgres_changes event. The strings and objects point into the parsed
+// frame, they are only valid during the callback.
+struct SupabaseChange
+{
+  const char *table = "";
+  const char *schema = "";
+  const char *type = ""; // INSERT, UPDATE or DELETE
+  const char *commitTimestamp = "";
+  JsonObjectConst record;    // null for DELETE
+  JsonObjectConst oldRecord; // only the primary key, unless the table has REPLICA IDENTITY FULL
+};
+
+typedef std::function<void(const SupabaseChange &change)> SupabaseChangeCallback;
+// payload is only valid during the callback
+typedef std::function<void(const char *event, JsonObjectConst payload)> SupabaseBroadcastCallback;
+
+// postgres_changes listeners per channel that can have a handler of their own
+#ifndef SUPABASE_REALTIME_LISTENERS
+#define SUPABASE_REALTIME_LISTENERS 8
+#endif
+
+// channels joined at the same time, the default realtime:* one included
+#ifndef SUPABASE_REALTIME_CHANNELS
+#define SUPABASE_REALTIME_CHANNELS 4
+#endif
+
+// heartbeats that can wait for their reply at the same time
+#ifndef SUPABASE_REALTIME_HEARTBEATS
+#define SUPABASE_REALTIME_HEARTBEATS 4
+#endif
+
+struct SupabaseHeartbeatStats
+{
+  uint32_t sent = 0;
+  uint32_t replies = 0;
+  uint32_t missed = 0;    // not answered before the next heartbeat was due
+  uint32_t deadLinks = 0; // reconnects because too many heartbeats in a row were missed
+  uint32_t lastRtt = 0;   // round trip in ms
+  uint32_t minRtt = 0;
+  uint32_t maxRtt = 0;
+  uint32_t rttSum = 0;    // divide by replies for the mean
+  uint8_t pending = 0;    // waiting for their reply now
+};
+
+class SupabaseRealtime;
+
+// One Phoenix channel with its own postgres_changes, presence and broadcast
+// config. Every channel joined with SupabaseRealtime::join() shares its
+// socket, so a second subscription doesn't cost a second TLS connection.
+// The channel belongs to the caller and has to outlive its membership.
+class SupabaseRealtimeChannel
+{
+private:
+  friend class SupabaseRealtime;
+  String topic; // with the realtime: prefix
+  SupabaseRealtime *realtime = nullptr;
+
+  enum State
+  {
+    CLOSED,
+    JOINING,
+    JOINED
+  };
+  State state = CLOSED;
+  uint32_t joinRef = 0; // ref of the last phx_join, the reply and our messages carry it
+
+  // Postgres Changes
+  JsonDocument postgresChanges;
+  // Same order as postgresChanges. The id is the one the server gave the
+  // subscription in its reply to phx_join, events carry it in payload.ids
+  struct Listener
+  {
+    uint32_t id = 0;
+    SupabaseChangeCallback handler;
+  };
+  Listener listeners[SUPABASE_REALTIME_LISTENERS];
+  uint8_t listenerCount = 0;
+  SupabaseChangeCallback changeHandler;
+
+  // Presence
+  bool isPresence = false;
+  String presenceName;
+
+  // Broadcast
+  bool isBroadcast = false;
+  bool broadcastSelf = false;
+  SupabaseBroadcastCallback broadcastHandler;
+
+  bool _configured();
+  void _joinReply(JsonObjectConst payload);
+  bool _dispatch(const SupabaseChange &change, JsonArrayConst ids);
+
+public:
+  // topic without the realtime: prefix, e.g. "device:42"
+  SupabaseRealtimeChannel(String topic = "*");
+
+  void addChangesListener(String table, String event, String schema, String filter);
+  // Listener with its own handler, its events reach the other handlers only
+  // when they also matched a listener without one
+  void addChangesListener(String table, String event, String schema, String filter, SupabaseChangeCallback handler);
+  // Changes of the listeners without a handler, before the ones of SupabaseRealtime
+  void onChange(SupabaseChangeCallback callback);
+  // Track the presence of this device on the channel
+  void sendPresence(String device_name);
+  // Receive broadcast messages, self also receives our own
+  void onBroadcast(SupabaseBroadcastCallback callback, bool self = false);
+  // Sends a broadcast message to the channel, json is an object. false while not joined
+  bool broadcast(const String &event, const String &json);
+
+  bool joined();
+  const String &getTopic();
+};
+
 class SupabaseRealtime
 {
 private:
+  friend class SupabaseRealtimeChannel;
   WebSocketsClient webSocket;
 
   String key;
@@ -28,48 +145,87 @@ private:
   String password;
   String data;
   String loginMethod;
-  bool useAuth;
+  bool useAuth = false;
+  int _token_request(const char *grant, const String &body);
   int _login_process();
-  unsigned int authTimeout = 0;
-  unsigned long loginTime;
-  String configAUTH;
+  int _renew();
+  int _login_retry();
+  SupabaseSession session;
+  unsigned long renewAt = 0;
+  uint8_t renewAttempts = 0;
 
-  // Initial config
-  const char *config = R"({"event":"phx_join","topic":"realtime:*","payload":{"config":{}},"ref":"1"})";
-  // Postgres Changes
-  bool isPostgresChanges = false;
-  JsonDocument postgresChanges;
-  // Presence
-  const char *jsonPresence = R"({"topic":"realtime:*","event":"presence","payload":{"type":"presence","event":"track","payload":{"user":"","online_at":""}},"ref":"2"})";
-  bool isPresence = false;
-  String presenceConfig;
-  // bool isBroadcast = false;  // Not implemented yet
-  // JsonDocument broadcastConfig; // Not implemented yet
-  JsonDocument jsonRealtimeConfig;
-  String configJSON;
+  // Channels, the default one (realtime:*) holds what's configured on SupabaseRealtime itself
+  SupabaseRealtimeChannel defaultChannel;
+  SupabaseRealtimeChannel *channels[SUPABASE_REALTIME_CHANNELS] = {};
+  uint8_t channelCount = 0;
+  bool connected = false;
+  uint32_t lastRef = 0; // refs are unique per socket
+  uint32_t _nextRef();
+  SupabaseRealtimeChannel *_channel(const char *topic);
+  bool _send(SupabaseRealtimeChannel &channel, const char *event, JsonDocument &payload, uint32_t ref = 0);
+  void _join(SupabaseRealtimeChannel &channel);
+  void _sendToken(SupabaseRealtimeChannel &channel);
 
-  // Heartbeat
+  // Heartbeat, each with its own ref so the reply tells the round trip. A
+  // half-open connection never answers, after heartbeatMaxMissed heartbeats
+  // in a row without a reply the socket is reconnected
   unsigned int last_ms = millis();
-  const char *jsonRealtimeHeartbeat = R"({"event":"heartbeat","topic":"phoenix","payload":{},"ref":"0"})";
-  const char *tokenConfig = R"({"topic":"realtime:*","event":"access_token","payload":{"access_token":""},"ref":"3"})";
+  unsigned long heartbeatInterval = 30000;
+  uint8_t heartbeatMaxMissed = 2;
+  struct Heartbeat
+  {
+    uint32_t ref = 0; // 0 when the slot is free
+    unsigned long sentAt = 0;
+  };
+  Heartbeat heartbeats[SUPABASE_REALTIME_HEARTBEATS];
+  SupabaseHeartbeatStats heartbeatStats;
+  bool _heartbeat();
+  void _heartbeatReply(uint32_t ref);
+  void _heartbeatReset();
+
+  // Retry policy, defaultRetryPolicy unless one is shared with setRetryPolicy()
+  SupabaseRetryPolicy defaultRetryPolicy;
+  SupabaseRetryPolicy *retryPolicy = nullptr;
+  SupabaseRetryPolicy &_retry();
+  uint8_t reconnectAttempts = 0;
 
-  void processMessage(uint8_t *payload);
+  // Frames are parsed once through a filter that keeps only what the
+  // handlers read: replies to phx_join, the ids and fields of SupabaseChange,
+  // broadcasts, or all of payload.data for the String handler
+  JsonDocument eventFilter;
+  void _eventFilter();
+  void processMessage(const uint8_t *payload, size_t length);
   void webSocketEvent(WStype_t type, uint8_t *payload, size_t length);
 
   std::function<void(String)> handler;
+  SupabaseChangeCallback changeHandler;
 
 public:
   SupabaseRealtime() {}
   void begin(String hostname, String key, void (*func)(String));
+  // The methods below configure the default channel, realtime:*
   void sendPresence(String device_name);
-  // void broadcast(); // Not implemented yet
   void addChangesListener(String table, String event, String schema, String filter);
+  // Listener with its own handler, its events reach the other handlers only
+  // when they also matched a listener without one
+  void addChangesListener(String table, String event, String schema, String filter, SupabaseChangeCallback handler);
+  // Typed handler of every channel, called instead of the String handler given to begin()
+  void onChange(SupabaseChangeCallback callback);
+  // Adds a channel, it is joined as soon as the socket is connected and
+  // again after every reconnect. false when SUPABASE_REALTIME_CHANNELS are in use
+  bool join(SupabaseRealtimeChannel &channel);
+  // Leaves the channel and forgets it, the other channels stay joined
+  void leave(SupabaseRealtimeChannel &channel);
   void listen();
   void loop();
   void end(); // A way to end the websocket process (if realtime.loop() is called it will reconnect automatically)
   int login_email(String email_a, String password_a);
   int login_phone(String phone_a, String password_a);
   bool isConnected(); // Check if WebSocket is connected
+  // Heartbeat every interval ms, reconnect once maxMissed in a row weren't answered
+  void setHeartbeat(unsigned long interval, uint8_t maxMissed = 2);
+  SupabaseHeartbeatStats getHeartbeatStats();
+  void setRetryPolicy(SupabaseRetryPolicy *policy); // bounded login retries and reconnect backoff
 };
 
 #endif
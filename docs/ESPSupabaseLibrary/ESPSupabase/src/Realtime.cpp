@@ -1,20 +1,9 @@
 #include "ESPSupabaseRealtime.h"
 
-// Internal functions
-String getEventTable(JsonDocument result)
-{
-  String table = result["payload"]["data"]["table"];
-  return table;
-}
-
-String getEventType(JsonDocument result)
-{
-  String type = result["payload"]["data"]["type"];
-  return type;
-}
-
-int SupabaseRealtime::_login_process()
+// POSTs to the token endpoint and keeps the session from its response
+int SupabaseRealtime::_token_request(const char *grant, const String &body)
 {
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
   HTTPClient Loginhttps;
   WiFiClientSecure *clientLogin = new WiFiClientSecure();
 
@@ -22,7 +11,7 @@ int SupabaseRealtime::_login_process()
 
   int httpCode;
   JsonDocument doc;
-  String url = "https://" + hostname + "/auth/v1/token?grant_type=password";
+  String url = "https://" + hostname + "/auth/v1/token?grant_type=" + grant;
   Serial.println("Beginning to login to " + url);
 
   if (Loginhttps.begin(*clientLogin, url))
@@ -30,23 +19,15 @@ int SupabaseRealtime::_login_process()
     Loginhttps.addHeader("apikey", key);
     Loginhttps.addHeader("Content-Type", "application/json");
 
-    String query = "{\"" + loginMethod + "\": \"" + phone_or_email + "\", \"password\": \"" + password + "\"}";
-    httpCode = Loginhttps.POST(query);
+    httpCode = Loginhttps.POST(body);
 
     if (httpCode > 0)
     {
       String data = Loginhttps.getString();
       deserializeJson(doc, data);
-      if (doc.containsKey("access_token") && !doc["access_token"].isNull() && doc["access_token"].is<String>() && !doc["access_token"].as<String>().isEmpty())
+      if (httpCode == 200 && session.update(doc))
       {
-        String USER_TOKEN = doc["access_token"].as<String>();
-        authTimeout = doc["expires_in"].as<int>() * 1000;
         Serial.println("Login Success");
-
-        JsonDocument authConfig;
-        deserializeJson(authConfig, tokenConfig);
-        authConfig["payload"]["access_token"] = USER_TOKEN;
-        serializeJson(authConfig, configAUTH);
       }
       else
       {
@@ -62,84 +43,116 @@ int SupabaseRealtime::_login_process()
     Loginhttps.end();
     delete clientLogin;
     clientLogin = NULL;
-
-    loginTime = millis();
   }
   else
   {
+    delete clientLogin;
     return -100;
   }
 
   return httpCode;
 }
 
-void SupabaseRealtime::addChangesListener(String table, String event, String schema, String filter)
+int SupabaseRealtime::_login_process()
 {
-  isPostgresChanges = true;
-  JsonDocument tableObj;
-
-  tableObj["event"] = event;
-  tableObj["schema"] = schema;
-  tableObj["table"] = table;
+  String query = "{\"" + loginMethod + "\": \"" + phone_or_email + "\", \"password\": \"" + password + "\"}";
+  return _token_request("password", query);
+}
 
-  if (filter != "")
+// Renews the access token with the refresh token, and only falls back to the
+// password when the refresh token was rejected
+int SupabaseRealtime::_renew()
+{
+  if (session.refreshToken.length() > 0)
   {
-    tableObj["filter"] = filter;
+    int httpCode = _token_request("refresh_token", "{\"refresh_token\": \"" + session.refreshToken + "\"}");
+    if (httpCode == 200 || SupabaseRetryPolicy::retryable(httpCode))
+    {
+      return httpCode;
+    }
   }
-
-  postgresChanges.add(tableObj);
+  return _login_process();
 }
 
-void SupabaseRealtime::sendPresence(String device_name)
+void SupabaseRealtime::addChangesListener(String table, String event, String schema, String filter)
 {
-  JsonDocument presence;
-  isPresence = true;
+  defaultChannel.addChangesListener(table, event, schema, filter);
+}
 
-  deserializeJson(presence, jsonPresence);
-  presence["payload"]["payload"]["user"] = device_name;
-  serializeJson(presence, presenceConfig);
+void SupabaseRealtime::addChangesListener(String table, String event, String schema, String filter, SupabaseChangeCallback handler)
+{
+  defaultChannel.addChangesListener(table, event, schema, filter, handler);
 }
 
-void SupabaseRealtime::listen()
+void SupabaseRealtime::sendPresence(String device_name)
 {
-  // Build Phoenix Channel phx_join message with correct structure
-  JsonDocument phxJoinMessage;
-  phxJoinMessage["event"] = "phx_join";
-  phxJoinMessage["topic"] = "realtime:*";
-  phxJoinMessage["ref"] = "1";
+  defaultChannel.sendPresence(device_name);
+}
 
-  // Build nested payload structure: payload.config.postgres_changes
-  JsonDocument configDoc;
+void SupabaseRealtime::onChange(SupabaseChangeCallback callback)
+{
+  changeHandler = callback;
+}
 
-  if (isPostgresChanges)
+bool SupabaseRealtime::join(SupabaseRealtimeChannel &channel)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
+  if (channel.realtime != this)
   {
-    configDoc["postgres_changes"] = postgresChanges;
+    if (channel.realtime || channelCount >= SUPABASE_REALTIME_CHANNELS)
+    {
+      Serial.printf("[Realtime] Can't join %s, raise SUPABASE_REALTIME_CHANNELS\n", channel.topic.c_str());
+      return false;
+    }
+    channel.realtime = this;
+    channels[channelCount] = &channel;
+    channelCount++;
   }
 
-  if (isPresence)
+  if (connected && channel.state == SupabaseRealtimeChannel::CLOSED)
   {
-    configDoc["presence"]["key"] = "";
+    _join(channel);
   }
-  // if (isBroadcast)
-  // {
-  //   // not implemented yet
-  //   // configDoc["broadcast"] = broadcastConfig;
-  // }
-
-  JsonDocument payloadDoc;
-  payloadDoc["config"] = configDoc;
+  return true;
+}
 
-  // Add access_token to payload for RLS authentication
-  payloadDoc["access_token"] = key;
+void SupabaseRealtime::leave(SupabaseRealtimeChannel &channel)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    if (channels[i] != &channel)
+    {
+      continue;
+    }
 
-  phxJoinMessage["payload"] = payloadDoc;
+    if (connected && channel.state != SupabaseRealtimeChannel::CLOSED)
+    {
+      JsonDocument payload;
+      payload.to<JsonObject>();
+      _send(channel, "phx_leave", payload);
+    }
+    channel.state = SupabaseRealtimeChannel::CLOSED;
+    channel.realtime = nullptr;
 
-  // Serialize Phoenix message
-  serializeJson(phxJoinMessage, configJSON);
+    channelCount--;
+    for (uint8_t j = i; j < channelCount; j++)
+    {
+      channels[j] = channels[j + 1];
+    }
+    channels[channelCount] = nullptr;
+    return;
+  }
+}
 
-  // Debug: Print the message being sent
-  Serial.println("[Realtime] Sending phx_join message:");
-  Serial.println(configJSON);
+void SupabaseRealtime::listen()
+{
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
+  // realtime:* is joined when it has something to listen to, or it is the only channel
+  if (defaultChannel._configured() || channelCount == 0)
+  {
+    join(defaultChannel);
+  }
 
   String slug = "/realtime/v1/websocket?apikey=" + String(key) + "&vsn=1.0.0";
 
@@ -148,6 +161,7 @@ void SupabaseRealtime::listen()
   // 2nd param: port 443 for WSS (WebSocket Secure)
   // 3rd param: url path with apikey
   // 4th param: NULL fingerprint to disable SSL certificate validation
+  SupabaseHeapScope socket(SupabaseHeap::WEBSOCKET);
   webSocket.beginSSL(
       hostname.c_str(),
       443,
@@ -158,43 +172,244 @@ void SupabaseRealtime::listen()
   webSocket.onEvent(std::bind(&SupabaseRealtime::webSocketEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 }
 
-void SupabaseRealtime::processMessage(uint8_t *payload)
+uint32_t SupabaseRealtime::_nextRef()
+{
+  lastRef++;
+  if (lastRef == 0)
+  {
+    lastRef++;
+  }
+  return lastRef;
+}
+
+SupabaseRealtimeChannel *SupabaseRealtime::_channel(const char *topic)
 {
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    if (channels[i]->topic == topic)
+    {
+      return channels[i];
+    }
+  }
+  return nullptr;
+}
+
+// Sends a Phoenix message on the channel, with a new ref unless one is given
+bool SupabaseRealtime::_send(SupabaseRealtimeChannel &channel, const char *event, JsonDocument &payload, uint32_t ref)
+{
+  JsonDocument message;
+  message["topic"] = channel.topic;
+  message["event"] = event;
+  message["payload"] = payload;
+  message["ref"] = String(ref ? ref : _nextRef());
+  message["join_ref"] = String(channel.joinRef);
+
+  String text;
+  serializeJson(message, text);
+  SupabaseHeapScope socket(SupabaseHeap::WEBSOCKET);
+  return webSocket.sendTXT(text);
+}
+
+// phx_join with the config of the channel, and the presence to track
+void SupabaseRealtime::_join(SupabaseRealtimeChannel &channel)
+{
+  JsonDocument payload;
+  JsonObject config = payload["config"].to<JsonObject>();
+
+  if (!channel.postgresChanges.isNull())
+  {
+    config["postgres_changes"] = channel.postgresChanges;
+  }
+  if (channel.isPresence)
+  {
+    config["presence"]["key"] = "";
+  }
+  if (channel.isBroadcast)
+  {
+    config["broadcast"]["self"] = channel.broadcastSelf;
+    config["broadcast"]["ack"] = false;
+  }
+
+  // the user's token when logged in, for RLS
+  payload["access_token"] = useAuth ? session.accessToken : key;
+
+  // the ids are only known again once phx_join is answered
+  for (uint8_t i = 0; i < channel.listenerCount; i++)
+  {
+    channel.listeners[i].id = 0;
+  }
+  channel.joinRef = _nextRef();
+  channel.state = SupabaseRealtimeChannel::JOINING;
+  Serial.printf("[Realtime] Joining %s\n", channel.topic.c_str());
+  _send(channel, "phx_join", payload, channel.joinRef);
+
+  if (channel.isPresence)
+  {
+    JsonDocument presence;
+    presence["type"] = "presence";
+    presence["event"] = "track";
+    presence["payload"]["user"] = channel.presenceName;
+    presence["payload"]["online_at"] = "";
+    _send(channel, "presence", presence);
+  }
+}
+
+void SupabaseRealtime::_sendToken(SupabaseRealtimeChannel &channel)
+{
+  JsonDocument payload;
+  payload["access_token"] = session.accessToken;
+  _send(channel, "access_token", payload);
+}
+
+void SupabaseRealtime::_eventFilter()
+{
+  eventFilter["topic"] = true;
+  eventFilter["event"] = true;
+  eventFilter["ref"] = true;
+  eventFilter["payload"]["ids"] = true;
+  eventFilter["payload"]["status"] = true;
+  eventFilter["payload"]["response"]["postgres_changes"][0]["id"] = true;
+  // broadcast
+  eventFilter["payload"]["event"] = true;
+  eventFilter["payload"]["payload"] = true;
+
+  if (!handler)
+  {
+    JsonObject data = eventFilter["payload"]["data"].to<JsonObject>();
+    data["table"] = true;
+    data["schema"] = true;
+    data["type"] = true;
+    data["commit_timestamp"] = true;
+    data["record"] = true;
+    data["old_record"] = true;
+  }
+  else
+  {
+    eventFilter["payload"]["data"] = true;
+  }
+}
+
+void SupabaseRealtime::processMessage(const uint8_t *payload, size_t length)
+{
+  if (eventFilter.isNull())
+  {
+    _eventFilter();
+  }
+
   JsonDocument result;
-  deserializeJson(result, payload);
-  String table = getEventTable(result);
-  if (table != "null")
+  if (deserializeJson(result, payload, length, DeserializationOption::Filter(eventFilter)))
+  {
+    return;
+  }
+
+  const char *topic = result["topic"] | "";
+  const char *event = result["event"] | "";
+  if (strcmp(topic, "phoenix") == 0)
+  {
+    if (strcmp(event, "phx_reply") == 0)
+    {
+      _heartbeatReply(strtoul(result["ref"] | "", nullptr, 10));
+    }
+    return;
+  }
+
+  SupabaseRealtimeChannel *channel = _channel(topic);
+  if (!channel)
+  {
+    return;
+  }
+
+  JsonObjectConst body = result["payload"];
+  if (strcmp(event, "phx_reply") == 0)
+  {
+    if (strtoul(result["ref"] | "", nullptr, 10) == channel->joinRef)
+    {
+      channel->_joinReply(body);
+    }
+    return;
+  }
+  if (strcmp(event, "phx_close") == 0 || strcmp(event, "phx_error") == 0)
+  {
+    // joined again with the next heartbeat
+    channel->state = SupabaseRealtimeChannel::CLOSED;
+    return;
+  }
+  if (strcmp(event, "broadcast") == 0)
+  {
+    if (channel->broadcastHandler)
+    {
+      channel->broadcastHandler(body["event"] | "", body["payload"]);
+    }
+    return;
+  }
+
+  // presence and system messages have no payload.data.table
+  JsonObjectConst data = body["data"];
+  const char *table = data["table"];
+  if (!table)
+  {
+    return;
+  }
+
+  SupabaseChange change;
+  change.table = table;
+  change.schema = data["schema"] | "";
+  change.type = data["type"] | "";
+  change.commitTimestamp = data["commit_timestamp"] | "";
+  change.record = data["record"];
+  change.oldRecord = data["old_record"];
+
+  if (channel->_dispatch(change, body["ids"]))
+  {
+    return;
+  }
+
+  if (changeHandler)
   {
-    String data = result["payload"]["data"];
-    handler(data);
-  };
+    changeHandler(change);
+  }
+  else if (handler)
+  {
+    String text;
+    serializeJson(data, text);
+    handler(text);
+  }
 }
 
 void SupabaseRealtime::webSocketEvent(WStype_t type, uint8_t *payload, size_t length)
 {
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
   switch (type)
   {
   case WStype_DISCONNECTED:
     Serial.println("[WSc] ❌ DISCONNECTED!");
+    connected = false;
+    _heartbeatReset();
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+      channels[i]->state = SupabaseRealtimeChannel::CLOSED;
+    }
+    // back off with jitter, so devices don't all reconnect at the same moment
+    if (reconnectAttempts < 16)
+    {
+      reconnectAttempts++;
+    }
+    webSocket.setReconnectInterval(_retry().backoff(reconnectAttempts));
     break;
   case WStype_CONNECTED:
     Serial.println("[WSc] ✅ CONNECTED to Supabase Realtime");
-    Serial.println("[WSc] Sending phx_join message...");
-    webSocket.sendTXT(configJSON);
-    if (useAuth)
-    {
-      Serial.println("[WSc] Sending access_token...");
-      webSocket.sendTXT(configAUTH);
-    }
-    if (isPresence)
+    connected = true;
+    reconnectAttempts = 0;
+    _heartbeatReset();
+    last_ms = millis();
+    for (uint8_t i = 0; i < channelCount; i++)
     {
-      Serial.println("[WSc] Sending presence...");
-      webSocket.sendTXT(presenceConfig);
+      _join(*channels[i]);
     }
     break;
   case WStype_TEXT:
     Serial.printf("[WSc] 📨 RECEIVED: %s\n", payload);
-    processMessage(payload);
+    processMessage(payload, length);
     break;
   case WStype_BIN:
     Serial.printf("[WSc] Binary data received: %u bytes\n", length);
@@ -218,24 +433,61 @@ void SupabaseRealtime::webSocketEvent(WStype_t type, uint8_t *payload, size_t le
 
 void SupabaseRealtime::loop()
 {
-  // Request AUTH token every 50 minutes (on defautlt timeout / 60 min)
-  if (useAuth && millis() - loginTime > authTimeout / 1.2)
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
+  // Renew the token ahead of its expiry, backing off when the renewal fails.
+  // The renewal has a short-lived connection of its own and the new token is
+  // pushed to the joined channels, so the socket stays up
+  if (useAuth && session.needsRenewal() && (renewAt == 0 || (long)(millis() - renewAt) >= 0))
   {
-    webSocket.disconnect();
-    _login_process();
+    if (_renew() == 200)
+    {
+      renewAt = 0;
+      renewAttempts = 0;
+      for (uint8_t i = 0; connected && i < channelCount; i++)
+      {
+        // a channel still joining gets it too, its phx_join had the old one
+        if (channels[i]->state != SupabaseRealtimeChannel::CLOSED)
+        {
+          _sendToken(*channels[i]);
+        }
+      }
+    }
+    else
+    {
+      if (renewAttempts < 16)
+      {
+        renewAttempts++;
+      }
+      renewAt = millis() + _retry().backoff(renewAttempts);
+      if (renewAt == 0)
+      {
+        renewAt = 1;
+      }
+    }
   }
-  else
+
   {
+    // frames are handled in webSocketEvent(), which counts as realtime again
+    SupabaseHeapScope socket(SupabaseHeap::WEBSOCKET);
     webSocket.loop();
   }
 
-  // send heartbeat every 30 seconds
-  if (millis() - last_ms > 30000)
+  // send heartbeat every 30 seconds (setHeartbeat())
+  if (millis() - last_ms > heartbeatInterval)
   {
     last_ms = millis();
-    webSocket.sendTXT(jsonRealtimeHeartbeat);
-    if (useAuth)
-      webSocket.sendTXT(configAUTH);
+    if (!connected || !_heartbeat())
+    {
+      return;
+    }
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+      // the server closed the channel (phx_error, phx_close, a failed join)
+      if (channels[i]->state == SupabaseRealtimeChannel::CLOSED)
+      {
+        _join(*channels[i]);
+      }
+    }
   }
 }
 
@@ -245,13 +497,155 @@ void SupabaseRealtime::begin(String hostname, String key, void (*func)(String))
   this->hostname = hostname;
   this->key = key;
   this->handler = func;
+  eventFilter.clear();
+}
+
+void SupabaseRealtime::setHeartbeat(unsigned long interval, uint8_t maxMissed)
+{
+  heartbeatInterval = interval;
+  heartbeatMaxMissed = maxMissed;
+  if (heartbeatMaxMissed < 1)
+  {
+    heartbeatMaxMissed = 1;
+  }
+  if (heartbeatMaxMissed > SUPABASE_REALTIME_HEARTBEATS)
+  {
+    heartbeatMaxMissed = SUPABASE_REALTIME_HEARTBEATS;
+  }
+}
+
+SupabaseHeartbeatStats SupabaseRealtime::getHeartbeatStats()
+{
+  SupabaseHeartbeatStats stats = heartbeatStats;
+  for (uint8_t i = 0; i < SUPABASE_REALTIME_HEARTBEATS; i++)
+  {
+    if (heartbeats[i].ref != 0)
+    {
+      stats.pending++;
+    }
+  }
+  return stats;
+}
+
+// Sends a heartbeat with a new ref. false when the link is dead: the last
+// heartbeatMaxMissed went unanswered, the socket is then reconnected
+bool SupabaseRealtime::_heartbeat()
+{
+  uint8_t pending = 0;
+  Heartbeat *slot = nullptr;
+  for (uint8_t i = 0; i < SUPABASE_REALTIME_HEARTBEATS; i++)
+  {
+    if (heartbeats[i].ref != 0)
+    {
+      pending++;
+    }
+    else if (!slot)
+    {
+      slot = &heartbeats[i];
+    }
+  }
+
+  // the one sent last time is still unanswered
+  if (pending > 0)
+  {
+    heartbeatStats.missed++;
+  }
+  if (pending >= heartbeatMaxMissed || !slot)
+  {
+    Serial.printf("[Realtime] 💀 %u heartbeats unanswered, reconnecting\n", pending);
+    heartbeatStats.deadLinks++;
+    _heartbeatReset();
+    SupabaseHeapScope socket(SupabaseHeap::WEBSOCKET);
+    webSocket.disconnect();
+    return false;
+  }
+
+  slot->ref = _nextRef();
+  slot->sentAt = millis();
+  heartbeatStats.sent++;
+
+  String message = "{\"event\":\"heartbeat\",\"topic\":\"phoenix\",\"payload\":{},\"ref\":\"" + String(slot->ref) + "\"}";
+  SupabaseHeapScope socket(SupabaseHeap::WEBSOCKET);
+  webSocket.sendTXT(message);
+  return true;
+}
+
+// The reply shows the link was alive when its heartbeat was sent, older
+// heartbeats still waiting are dropped, they were counted as missed already.
+// Newer ones keep waiting for their own reply.
+void SupabaseRealtime::_heartbeatReply(uint32_t ref)
+{
+  if (ref == 0)
+  {
+    return;
+  }
+  for (uint8_t i = 0; i < SUPABASE_REALTIME_HEARTBEATS; i++)
+  {
+    // refs wrap around, compared by their distance
+    if (heartbeats[i].ref == 0 || (int32_t)(ref - heartbeats[i].ref) < 0)
+    {
+      continue;
+    }
+    if (heartbeats[i].ref == ref)
+    {
+      uint32_t rtt = millis() - heartbeats[i].sentAt;
+      heartbeatStats.replies++;
+      heartbeatStats.lastRtt = rtt;
+      heartbeatStats.rttSum += rtt;
+      if (heartbeatStats.replies == 1 || rtt < heartbeatStats.minRtt)
+      {
+        heartbeatStats.minRtt = rtt;
+      }
+      if (rtt > heartbeatStats.maxRtt)
+      {
+        heartbeatStats.maxRtt = rtt;
+      }
+    }
+    heartbeats[i].ref = 0;
+  }
+}
+
+void SupabaseRealtime::_heartbeatReset()
+{
+  for (uint8_t i = 0; i < SUPABASE_REALTIME_HEARTBEATS; i++)
+  {
+    heartbeats[i].ref = 0;
+  }
+}
+
+bool SupabaseRealtime::isConnected()
+{
+  return connected;
 }
 
 void SupabaseRealtime::end()
 {
+  SupabaseHeapScope heap(SupabaseHeap::WEBSOCKET);
   webSocket.disconnect();
 }
 
+SupabaseRetryPolicy &SupabaseRealtime::_retry()
+{
+  return retryPolicy ? *retryPolicy : defaultRetryPolicy;
+}
+
+void SupabaseRealtime::setRetryPolicy(SupabaseRetryPolicy *policy)
+{
+  retryPolicy = policy;
+}
+
+// Logs in, retrying as the retry policy allows instead of forever
+int SupabaseRealtime::_login_retry()
+{
+  int httpCode = _login_process();
+  for (uint8_t attempt = 1; SupabaseRetryPolicy::retryable(httpCode) && _retry().shouldRetry(attempt); attempt++)
+  {
+    delay(_retry().backoff(attempt));
+    httpCode = _login_process();
+  }
+  return httpCode;
+}
+
 int SupabaseRealtime::login_email(String email_a, String password_a)
 {
   useAuth = true;
@@ -259,12 +653,7 @@ int SupabaseRealtime::login_email(String email_a, String password_a)
   phone_or_email = email_a;
   password = password_a;
 
-  int httpCode = 0;
-  while (httpCode <= 0)
-  {
-    httpCode = _login_process();
-  }
-  return httpCode;
+  return _login_retry();
 }
 
 int SupabaseRealtime::login_phone(String phone_a, String password_a)
@@ -274,10 +663,5 @@ int SupabaseRealtime::login_phone(String phone_a, String password_a)
   phone_or_email = phone_a;
   password = password_a;
 
-  int httpCode = 0;
-  while (httpCode <= 0)
-  {
-    httpCode = _login_process();
-  }
-  return httpCode;
+  return _login_retry();
 }
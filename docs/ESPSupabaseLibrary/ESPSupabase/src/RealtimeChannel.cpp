@@ -0,0 +1,156 @@
+#include "ESPSupabaseRealtime.h"
+
+SupabaseRealtimeChannel::SupabaseRealtimeChannel(String topic)
+    : topic("realtime:" + topic)
+{
+}
+
+void SupabaseRealtimeChannel::addChangesListener(String table, String event, String schema, String filter)
+{
+  addChangesListener(table, event, schema, filter, nullptr);
+}
+
+void SupabaseRealtimeChannel::addChangesListener(String table, String event, String schema, String filter, SupabaseChangeCallback handler)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REALTIME);
+  JsonDocument tableObj;
+
+  tableObj["event"] = event;
+  tableObj["schema"] = schema;
+  tableObj["table"] = table;
+
+  if (filter != "")
+  {
+    tableObj["filter"] = filter;
+  }
+
+  postgresChanges.add(tableObj);
+
+  if (listenerCount < SUPABASE_REALTIME_LISTENERS)
+  {
+    listeners[listenerCount].handler = handler;
+    listenerCount++;
+  }
+  else if (handler)
+  {
+    Serial.println("[Realtime] Too many listeners, raise SUPABASE_REALTIME_LISTENERS");
+  }
+}
+
+void SupabaseRealtimeChannel::onChange(SupabaseChangeCallback callback)
+{
+  changeHandler = callback;
+}
+
+void SupabaseRealtimeChannel::sendPresence(String device_name)
+{
+  isPresence = true;
+  presenceName = device_name;
+}
+
+void SupabaseRealtimeChannel::onBroadcast(SupabaseBroadcastCallback callback, bool self)
+{
+  isBroadcast = true;
+  broadcastSelf = self;
+  broadcastHandler = callback;
+}
+
+bool SupabaseRealtimeChannel::broadcast(const String &event, const String &json)
+{
+  if (state != JOINED || !realtime)
+  {
+    return false;
+  }
+
+  JsonDocument payload;
+  payload["type"] = "broadcast";
+  payload["event"] = event;
+  payload["payload"] = serialized(json);
+  return realtime->_send(*this, "broadcast", payload);
+}
+
+bool SupabaseRealtimeChannel::joined()
+{
+  return state == JOINED;
+}
+
+const String &SupabaseRealtimeChannel::getTopic()
+{
+  return topic;
+}
+
+bool SupabaseRealtimeChannel::_configured()
+{
+  return !postgresChanges.isNull() || isPresence || isBroadcast;
+}
+
+// The reply lists the subscriptions in the order they were joined with
+void SupabaseRealtimeChannel::_joinReply(JsonObjectConst payload)
+{
+  const char *status = payload["status"] | "";
+  if (strcmp(status, "ok") != 0)
+  {
+    Serial.printf("[Realtime] Joining %s failed: %s\n", topic.c_str(), status);
+    state = CLOSED;
+    return;
+  }
+  state = JOINED;
+
+  uint8_t i = 0;
+  for (JsonVariantConst subscription : payload["response"]["postgres_changes"].as<JsonArrayConst>())
+  {
+    if (i >= listenerCount)
+    {
+      break;
+    }
+    listeners[i].id = subscription["id"].as<uint32_t>();
+    i++;
+  }
+}
+
+// ids of the subscriptions the change matched. Listeners with a handler get
+// it there, if one of them has none it also goes to the channel's handler.
+// false when that is still to do, SupabaseRealtime then hands it to its own
+bool SupabaseRealtimeChannel::_dispatch(const SupabaseChange &change, JsonArrayConst ids)
+{
+  bool handled = false;
+  bool unhandled = false; // a matched listener without a handler
+  for (JsonVariantConst id : ids)
+  {
+    uint32_t value = id.as<uint32_t>();
+    bool found = false;
+    for (uint8_t i = 0; i < listenerCount; i++)
+    {
+      if (listeners[i].id != value)
+      {
+        continue;
+      }
+      found = true;
+      if (listeners[i].handler)
+      {
+        listeners[i].handler(change);
+        handled = true;
+      }
+      else
+      {
+        unhandled = true;
+      }
+    }
+    if (!found)
+    {
+      // a listener past SUPABASE_REALTIME_LISTENERS
+      unhandled = true;
+    }
+  }
+
+  if (handled && !unhandled)
+  {
+    return true;
+  }
+  if (changeHandler)
+  {
+    changeHandler(change);
+    return true;
+  }
+  return false;
+}
@@ -9,378 +9,632 @@ void Supabase::_check_last_string()
   }
 }
 
-int Supabase::_login_process()
-{
+// Discards whatever is left of a response body so a kept-alive connection
+// is clean for the next request
+class SupabaseNullStream : public Stream
+{
+public:
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  size_t write(uint8_t) { return 1; }
+  size_t write(const uint8_t *buffer, size_t size) { return size; }
+};
+
+// POSTs to the token endpoint and keeps the session from its response
+int Supabase::_token_request(const char *grant, const String &body)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
   int httpCode;
   JsonDocument doc;
-  Serial.println("Beginning to login..");
 
-  if (https.begin(client, hostname + "/auth/v1/token?grant_type=password"))
+  if (!_begin(hostname + "/auth/v1/token?grant_type=" + grant))
   {
-    https.addHeader("apikey", key);
-    https.addHeader("Content-Type", "application/json");
-
-    String query = "{\"" + loginMethod + "\": \"" + phone_or_email + "\", \"password\": \"" + password + "\"}";
-    httpCode = https.POST(query);
+    return -100;
+  }
+  https.addHeader("apikey", key);
+  https.addHeader("Content-Type", "application/json");
+  httpCode = _send("POST", body);
 
-    if (httpCode > 0)
+  if (httpCode > 0)
+  {
+    String data = https.getString();
+    deserializeJson(doc, data);
+    if (httpCode == 200 && session.update(doc))
     {
-      String data = https.getString();
-      deserializeJson(doc, data);
-      if (doc.containsKey("access_token") && !doc["access_token"].isNull() && doc["access_token"].is<String>() && !doc["access_token"].as<String>().isEmpty())
-      {
-        USER_TOKEN = doc["access_token"].as<String>();
-        authTimeout = doc["expires_in"].as<int>() * 1000;
-        Serial.println("Login Success");
-      }
-      else
-      {
-        Serial.println("Login Failed: Invalid access token in response");
-      }
+      USER_TOKEN = session.accessToken;
+      Serial.println("Login Success");
     }
     else
     {
-      Serial.println(phone_or_email);
-      Serial.println(password);
-
-      Serial.print("Login Failed : ");
-      Serial.println(httpCode);
+      Serial.println("Login Failed: Invalid access token in response");
     }
-
-    https.end();
-    loginTime = millis();
   }
   else
   {
-    return -100;
+    Serial.print("Login Failed : ");
+    Serial.println(httpCode);
   }
 
+  _end();
   return httpCode;
 }
 
-void Supabase::begin(String hostname_a, String key_a)
-{
-  client.setInsecure();
-  hostname = hostname_a;
-  key = key_a;
-}
-String Supabase::getQuery()
+int Supabase::_login_process()
 {
-  String temp = url_query;
-  urlQuery_reset();
-  return hostname + "/rest/v1/" + temp;
+  Serial.println("Beginning to login..");
+  String query = "{\"" + loginMethod + "\": \"" + phone_or_email + "\", \"password\": \"" + password + "\"}";
+  return _token_request("password", query);
 }
-// query reset
-void Supabase::urlQuery_reset()
+
+int Supabase::_refresh_process()
 {
-  url_query = "";
+  Serial.println("Refreshing session..");
+  return _token_request("refresh_token", "{\"refresh_token\": \"" + session.refreshToken + "\"}");
 }
-// membuat Query Builder
-Supabase &Supabase::Supabase::from(String table)
+
+// Renews the access token with the refresh token, and only falls back to the
+// password when the refresh token was rejected
+int Supabase::_renew()
 {
-  url_query += (table + "?");
-  return *this;
+  if (session.refreshToken.length() > 0)
+  {
+    int httpCode = _refresh_process();
+    if (httpCode == 200 || SupabaseRetryPolicy::retryable(httpCode))
+    {
+      return httpCode;
+    }
+  }
+  return _login_process();
 }
 
-int Supabase::insert(String table, String json, bool upsert)
+// Sends a request and leaves its response body unread on the connection.
+// Failed attempts are retried as the retry policy allows; requests that are
+// not idempotent only when the connection could not be opened at all.
+int Supabase::_open(const char *method, const String &url, const String &payload, const String &prefer, const char *accept)
 {
+  bool idempotent = SupabaseRetryPolicy::idempotent(method);
   int httpCode;
-  if (https.begin(client, hostname + "/rest/v1/" + table))
+  for (uint8_t attempt = 1;; attempt++)
   {
-    https.addHeader("apikey", key);
-    https.addHeader("Content-Type", "application/json");
-
-    String preferHeader = "return=representation";
-    if (upsert)
+    _check_auth();
+    if (!_begin(url))
     {
-      preferHeader += ",resolution=merge-duplicates";
+      httpCode = -100;
     }
-    https.addHeader("Prefer", preferHeader);
-
-    if (useAuth)
+    else
     {
-      unsigned long t_now = millis();
-      if (t_now - loginTime >= authTimeout)
+      https.addHeader("apikey", key);
+      https.addHeader("Content-Type", "application/json");
+      if (prefer.length() > 0)
       {
-        _login_process();
+        https.addHeader("Prefer", prefer);
       }
-      https.addHeader("Authorization", "Bearer " + USER_TOKEN);
+      if (accept)
+      {
+        https.addHeader("Accept", accept);
+      }
+      if (useAuth)
+      {
+        https.addHeader("Authorization", "Bearer " + USER_TOKEN);
+      }
+      httpCode = _send(method, payload);
     }
-    httpCode = https.POST(json);
-    https.end();
-  }
-  else
-  {
-    return -100;
+
+    bool retry = idempotent ? SupabaseRetryPolicy::retryable(httpCode) : (httpCode == -100 || httpCode == HTTPC_ERROR_CONNECTION_REFUSED);
+    if (!retry || !_retry().shouldRetry(attempt))
+    {
+      return httpCode;
+    }
+
+    _end(httpCode > 0);
+    unsigned long wait = _retry().backoff(attempt);
+    Serial.printf("Request failed (%d), retrying in %lu ms\n", httpCode, wait);
+    delay(wait);
   }
-  return httpCode;
 }
 
-Supabase &Supabase::select(String colls)
+SupabaseRetryPolicy &Supabase::_retry()
 {
-  url_query += ("select=" + colls);
-  return *this;
+  return retryPolicy ? *retryPolicy : defaultRetryPolicy;
 }
-Supabase &Supabase::update(String table)
+
+void Supabase::setRetryPolicy(SupabaseRetryPolicy *policy)
 {
-  url_query += (table + "?");
-  return *this;
+  retryPolicy = policy;
 }
 
-int Supabase::upload(String bucket, String filename, String mime_type, uint8_t *buffer, uint32_t size)
+void Supabase::setMetrics(SupabaseMetrics *metrics_a)
 {
-  int httpCode = 0;
-
-  // Gets protocol out of hostname.
-  int index = hostname.indexOf("//");
-  String hostname_no_prot = hostname.substring(index + 2, hostname.length());
-
-  char hostname_char[hostname_no_prot.length() + 1];
-  hostname_no_prot.toCharArray(hostname_char, hostname_no_prot.length() + 1);
-
-  String finalPath = hostname + "/storage/v1/object/" + bucket + "/" + filename;
-
-  // Make a HTTP request and add HTTP headers
-  String boundary = "esp32-supabase-boundary";
+  metrics = metrics_a;
+}
 
-  // Request Main Header
-  String httpMainHeader = "POST " + finalPath + " HTTP/1.1\r\n";
-  httpMainHeader += "Host: " + hostname_no_prot + "\r\n";
-  httpMainHeader += "apikey: " + key + "\r\n";
-  httpMainHeader += "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n";
+bool Supabase::_isChunked()
+{
+  return https.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+}
 
-  if (useAuth)
+// Sends a request and sets up body to read its response. With compression on
+// the request is written by hand, HTTPClient always sends its own
+// Accept-Encoding header. Returns the http code, the body must be finished
+// with _closeBody() unless it is <= 0.
+int Supabase::_openBody(const char *method, const String &url, const String &payload, SupabaseBodyStream &body, bool &gzip, const char *accept, const String &prefer)
+{
+  gzip = false;
+  bodyRaw = acceptGzip;
+  if (bodyRaw)
   {
-    unsigned long t_now = millis();
-    if (t_now - loginTime >= authTimeout)
+    SupabasePrepared request = prepare(method, url.substring(hostname.length()), prefer, accept ? accept : "");
+    static const char *keys[] = {"content-encoding"};
+    String encoding;
+    int httpCode = _executeOpen(request, payload, nullptr, body, bodyClose, keys, &encoding, 1);
+    gzip = encoding.equalsIgnoreCase("gzip");
+    if (httpCode > 0 && gzip && !_inflate(body))
     {
-      _login_process();
+      // the compressed bytes are no use to the caller
+      _closeBody(body);
+      return -102;
     }
-
-    httpMainHeader += "Authorization: Bearer " + USER_TOKEN + "\r\n";
+    return httpCode;
   }
 
-  httpMainHeader += "User-Agent: ESP32/Supabase\r\n";
-  httpMainHeader += "Keep-Alive: 3600\r\n";
-  httpMainHeader += "Connection: keep-alive\r\n";
-
-  // request Content Header
-  String contentHeader = "--" + boundary + "\r\n";
-  contentHeader += "Content-Disposition: form-data; name=\"" + filename + "\"; filename=\"" + filename + "\"\r\n";
-  contentHeader += "Content-Type: " + mime_type + "\r\n\r\n";
-
-  // request Ending Header
-  String endingHeader = "\r\n--" + boundary + "--\r\n\r\n";
-
-  // content length
-  int contentLength = contentHeader.length() + endingHeader.length();
-
-  httpMainHeader += "Content-Length: " + String(contentLength + size) + "\n\n";
+  int httpCode = _open(method, url, payload, prefer, accept);
+  if (httpCode <= 0)
+  {
+    _end();
+    return httpCode;
+  }
+  body.begin(https.getStream(), https.getSize(), _isChunked());
+  body.setTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT);
+  return httpCode;
+}
 
-  Serial.printf("Hostname: %s\n\r", hostname_char);
+void Supabase::_closeBody(SupabaseBodyStream &body)
+{
+  inflate.end();
+  bool drained = body.drain();
+  if (metrics)
+  {
+    requestTimer.bytes(0, body.bytesRead());
+  }
+  if (bodyRaw)
+  {
+    _rawEnd(bodyClose || !drained);
+    return;
+  }
+  if (!drained)
+  {
+    client.stop();
+  }
+  _end();
+}
 
-  if (!client.connected())
+// Starts decompressing a gzip body, false when its window can't be allocated
+bool Supabase::_inflate(SupabaseBodyStream &body)
+{
+  if (!inflate.begin(body))
   {
-    // This needs further testing, might need to change to port 80.
-    client.connect(hostname_char, 443);
+    Serial.println("Not enough memory to decompress the response");
+    return false;
+  }
+  inflate.setTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT);
+  return true;
+}
 
-    if (!client.connected())
-    {
-      return 0;
-    }
+// The response as it should be read, through inflate when it is compressed
+Stream &Supabase::_decoded(SupabaseBodyStream &body, bool gzip)
+{
+  if (gzip)
+  {
+    return inflate;
   }
+  return body;
+}
 
-  // send post header
-  client.write((uint8_t *)httpMainHeader.c_str(), httpMainHeader.length());
+int Supabase::_parse(const char *method, const String &url, const String &payload, JsonDocument &doc, JsonDocument *filter)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool gzip;
+  int httpCode = _openBody(method, url, payload, body, gzip);
+  if (httpCode <= 0)
+  {
+    return httpCode;
+  }
 
-  Serial.printf("HTTP Request:\n\r%s\n\r", httpMainHeader.c_str());
-  Serial.printf("\n\r%s\n\r", contentHeader.c_str());
-  Serial.printf("\n\r(file of %u bytes)\n\r", size);
-  Serial.printf("\n\r%s\n\r", endingHeader.c_str());
+  Stream &in = _decoded(body, gzip);
 
-  client.write((uint8_t *)contentHeader.c_str(), contentHeader.length());
+  DeserializationError error;
+  if (filter)
+  {
+    error = deserializeJson(doc, in, DeserializationOption::Filter(*filter));
+  }
+  else
+  {
+    error = deserializeJson(doc, in);
+  }
+  if (error)
+  {
+    Serial.print("Response parse failed: ");
+    Serial.println(error.c_str());
+  }
 
-  const uint16_t chunkSize = 255;
-  uint32_t remainingBytes = size;
+  _closeBody(body);
+  return httpCode;
+}
 
-  while (remainingBytes)
+// Reads a JSON array one element at a time, so only one row is ever in memory
+int Supabase::_parseEach(const char *method, const String &url, const String &payload, SupabaseRowCallback onRow, JsonDocument *filter)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool gzip;
+  int httpCode = _openBody(method, url, payload, body, gzip);
+  if (httpCode <= 0)
   {
-    uint8_t bytesToRead = remainingBytes >= chunkSize ? chunkSize : remainingBytes;
+    return httpCode;
+  }
 
-    client.write(buffer + (size - remainingBytes), bytesToRead);
+  Stream &in = _decoded(body, gzip);
 
-    remainingBytes -= bytesToRead;
+  if (httpCode >= 200 && httpCode < 300 && in.find("["))
+  {
+    JsonDocument row;
+    do
+    {
+      DeserializationError error;
+      if (filter)
+      {
+        error = deserializeJson(row, in, DeserializationOption::Filter(*filter));
+      }
+      else
+      {
+        error = deserializeJson(row, in);
+      }
+      if (error)
+      {
+        break;
+      }
+      onRow(row.as<JsonObjectConst>());
+    } while (in.findUntil(",", "]"));
   }
 
-  client.write((uint8_t *)endingHeader.c_str(), endingHeader.length());
-
-  bool firstLine = true;
+  _closeBody(body);
+  return httpCode;
+}
 
-  while (client.connected())
+// Renews the token when it already expired. poll() renews it ahead of time
+// in the background, so this only happens when poll() isn't used.
+// Must be called before _begin(), the token request shares the same HTTPClient.
+void Supabase::_check_auth()
+{
+  if (useAuth && session.expired())
   {
-    String line = client.readStringUntil('\n');
-    line.trim(); // remove \r
+    _renew();
+  }
+}
 
-    if (firstLine)
+bool Supabase::_begin(const String &url)
+{
+  if (client.connected())
+  {
+    if (!keepAlive)
     {
-      if (line == "")
-        continue;
-
-      int codePos = line.indexOf(' ') + 1;
-      httpCode = line.substring(codePos, line.indexOf(' ', codePos)).toInt();
-      firstLine = false;
-      Serial.printf("Return Code: %d\n\r", httpCode);
+      client.stop();
     }
-
-    Serial.printf("%s\n\r", line.c_str());
-
-    if (line == "")
+    else if (millis() - lastActivity >= keepAliveIdleTimeout)
     {
-      break;
+      // close it ourselves before the server does, so we never write
+      // into a half-closed socket
+      client.stop();
+      connectionStats.idleCloses++;
     }
   }
 
-  String response = client.readStringUntil('\n');
-
-  Serial.printf("HTTP Response:\n\r");
-  Serial.printf("==========\n\r");
-  Serial.printf("%s\n\r", response.c_str());
-  Serial.printf("==========\n\r");
-  Serial.printf("HTTP End\n\r");
-
-  Serial.printf("Return Code: %d\n\r", httpCode);
+  static const char *headerKeys[] = {"Transfer-Encoding"};
 
-  return httpCode;
+  if (metrics)
+  {
+    requestTimer.begin(*metrics, url.c_str());
+  }
+  https.setReuse(keepAlive);
+  if (!https.begin(client, url))
+  {
+    if (metrics)
+    {
+      requestTimer.response(-100);
+      requestTimer.end();
+    }
+    return false;
+  }
+  https.collectHeaders(headerKeys, 1);
+  return true;
 }
 
-int Supabase::upload(String bucket, String filename, String mime_type, Stream *stream, uint32_t size)
+int Supabase::_send(const char *method, const String &payload)
 {
-  int httpCode = 0;
-
-  // Gets protocol out of hostname.
-  int index = hostname.indexOf("//");
-  String hostname_no_prot = hostname.substring(index + 2, hostname.length());
+  bool reused = client.connected();
+  int httpCode = https.sendRequest(method, payload);
 
-  char hostname_char[hostname_no_prot.length() + 1];
-  hostname_no_prot.toCharArray(hostname_char, hostname_no_prot.length() + 1);
+  // The server dropped the kept-alive connection while we were idle. When
+  // the header couldn't be written nothing reached the server and the
+  // request is sent again. A connection lost later may have been processed
+  // already, so then only idempotent methods are resent (a POST or PATCH
+  // could insert or apply twice)
+  bool unsent = httpCode == HTTPC_ERROR_SEND_HEADER_FAILED || httpCode == HTTPC_ERROR_NOT_CONNECTED;
+  if (reused && (unsent || (httpCode == HTTPC_ERROR_CONNECTION_LOST && SupabaseRetryPolicy::idempotent(method))))
+  {
+    client.stop();
+    connectionStats.reconnects++;
+    reused = false;
+    httpCode = https.sendRequest(method, payload);
+  }
 
-  String finalPath = hostname + "/storage/v1/object/" + bucket + "/" + filename;
+  if (httpCode != HTTPC_ERROR_CONNECTION_REFUSED)
+  {
+    if (reused)
+    {
+      connectionStats.reused++;
+    }
+    else
+    {
+      connectionStats.opened++;
+    }
+  }
 
-  // Make a HTTP request and add HTTP headers
-  String boundary = "esp32-supabase-boundary";
+  if (metrics)
+  {
+    // HTTPClient connects, sends and waits in one call, all of it is FIRST_BYTE here
+    requestTimer.reused(reused);
+    requestTimer.bytes(payload.length(), 0);
+    requestTimer.response(httpCode);
+  }
 
-  // Request Main Header
-  String httpMainHeader = "POST " + finalPath + " HTTP/1.1\r\n";
-  httpMainHeader += "Host: " + hostname_no_prot + "\r\n";
-  httpMainHeader += "apikey: " + key + "\r\n";
-  httpMainHeader += "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n";
+  lastActivity = millis();
+  return httpCode;
+}
 
-  if (useAuth)
+void Supabase::_end(bool discardBody)
+{
+  if (discardBody && keepAlive && https.getSize() != 0)
   {
-    unsigned long t_now = millis();
-    if (t_now - loginTime >= authTimeout)
+    SupabaseNullStream sink;
+    int skipped = https.writeToStream(&sink);
+    if (metrics && skipped > 0)
     {
-      _login_process();
+      requestTimer.bytes(0, skipped);
     }
+  }
+  https.end();
+  lastActivity = millis();
+  if (metrics)
+  {
+    requestTimer.end();
+  }
+}
+
+void Supabase::begin(String hostname_a, String key_a)
+{
+  client.setInsecure();
+  hostname = hostname_a;
+  key = key_a;
 
-    httpMainHeader += "Authorization: Bearer " + USER_TOKEN + "\r\n";
+  // hostname without protocol, for requests written by hand
+  int index = hostname.indexOf("//");
+  host = index >= 0 ? hostname.substring(index + 2) : hostname;
+}
+void Supabase::setKeepAlive(bool enable, unsigned long idleTimeout)
+{
+  keepAlive = enable;
+  keepAliveIdleTimeout = idleTimeout;
+  if (!keepAlive)
+  {
+    disconnect();
   }
+}
 
-  httpMainHeader += "User-Agent: ESP32/Supabase\r\n";
-  httpMainHeader += "Keep-Alive: 3600\r\n";
-  httpMainHeader += "Connection: keep-alive\r\n";
+void Supabase::setCompression(bool gzip)
+{
+  acceptGzip = gzip;
+}
 
-  // request Content Header
-  String contentHeader = "--" + boundary + "\r\n";
-  contentHeader += "Content-Disposition: form-data; name=\"" + filename + "\"; filename=\"" + filename + "\"\r\n";
-  contentHeader += "Content-Type: " + mime_type + "\r\n\r\n";
+void Supabase::disconnect()
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  if (client.connected())
+  {
+    client.stop();
+  }
+}
 
-  // request Ending Header
-  String endingHeader = "\r\n--" + boundary + "--\r\n\r\n";
+SupabaseConnectionStats Supabase::getConnectionStats()
+{
+  return connectionStats;
+}
 
-  // content length
-  int contentLength = contentHeader.length() + endingHeader.length();
+String Supabase::getQuery()
+{
+  String temp = url_query;
+  urlQuery_reset();
+  return hostname + "/rest/v1/" + temp;
+}
+// query reset
+void Supabase::urlQuery_reset()
+{
+  url_query = "";
+}
+// membuat Query Builder
+Supabase &Supabase::Supabase::from(String table)
+{
+  url_query += (table + "?");
+  return *this;
+}
 
-  httpMainHeader += "Content-Length: " + String(contentLength + size) + "\n\n";
+int Supabase::insert(String table, String json, bool upsert)
+{
+  // the inserted row isn't returned to the caller, so don't ask for it back
+  return _write("POST", hostname + "/rest/v1/" + table, json, SupabaseWriteOptions().upsert(upsert), nullptr);
+}
 
-  Serial.printf("Hostname: %s\n\r", hostname_char);
+int Supabase::insert(String table, String json, const SupabaseWriteOptions &options, String *response)
+{
+  return _write("POST", hostname + "/rest/v1/" + table, json, options, response);
+}
 
-  if (!client.connected())
+// Sends an insert or update shaped by options, the response body goes to
+// response when it is given and discarded otherwise
+int Supabase::_write(const char *method, String url, const String &json, const SupabaseWriteOptions &options, String *response)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  if (options.getColumns())
   {
-    // This needs further testing, might need to change to port 80.
-    client.connect(hostname_char, 443);
+    url += url.indexOf('?') >= 0 ? "&columns=" : "?columns=";
+    url += options.getColumns();
+  }
 
-    if (!client.connected())
-    {
-      return 0;
-    }
+  if (!response)
+  {
+    int httpCode = _open(method, url, json, options.prefer());
+    _end(httpCode > 0);
+    return httpCode;
   }
 
-  // send post header
-  client.write((uint8_t *)httpMainHeader.c_str(), httpMainHeader.length());
+  SupabaseBodyStream body;
+  bool gzip;
+  int httpCode = _openBody(method, url, json, body, gzip, nullptr, options.prefer());
+  if (httpCode <= 0)
+  {
+    *response = "";
+    return httpCode;
+  }
 
-  Serial.printf("HTTP Request:\n\r%s\n\r", httpMainHeader.c_str());
-  Serial.printf("\n\r%s\n\r", contentHeader.c_str());
-  Serial.printf("\n\r(file of %u bytes)\n\r", size);
-  Serial.printf("\n\r%s\n\r", endingHeader.c_str());
+  *response = _decoded(body, gzip).readString();
+  _closeBody(body);
+  return httpCode;
+}
 
-  client.write((uint8_t *)contentHeader.c_str(), contentHeader.length());
+void Supabase::beginBatch(String table, uint16_t maxRows, unsigned long maxAge, bool upsert)
+{
+  beginBatch(table, maxRows, maxAge, SupabaseWriteOptions().upsert(upsert));
+}
 
-  const uint16_t chunkSize = 255;
-  uint64_t availableBytes = stream->available();
+void Supabase::beginBatch(String table, uint16_t maxRows, unsigned long maxAge, const SupabaseWriteOptions &options)
+{
+  batchTable = table;
+  batchMaxRows = maxRows > 0 ? maxRows : 1;
+  batchMaxAge = maxAge;
+  batchOptions = options;
+  // nothing of a batch is read back
+  batchOptions.returning(SupabaseWriteOptions::MINIMAL);
+  batchBody = "";
+  batchRows = 0;
+  batchRetryAt = 0;
+  batchFailures = 0;
+}
 
-  while (availableBytes)
+// Appends one row (a JSON object) to the batch. Returns 0 while the row is
+// only buffered, the http response code when the batch got flushed, or -103
+// when the row doesn't fit the SUPABASE_BATCH_MAX_BYTES left.
+int Supabase::insertBatch(String json)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  // '[' or ',' before the row and the closing ']'
+  if (batchBody.length() + json.length() + 2 > SUPABASE_BATCH_MAX_BYTES)
   {
-    uint8_t bytesToRead = availableBytes >= chunkSize ? chunkSize : availableBytes;
+    Serial.printf("Batch full (%u rows), row rejected\n", batchRows);
+    return -103;
+  }
 
-    uint8_t buffer[bytesToRead];
+  if (batchRows == 0)
+  {
+    // one allocation for the whole batch instead of one per row
+    batchBody.reserve((json.length() + 1) * batchMaxRows + 2);
+    batchBody = "[";
+    batchStarted = millis();
+  }
+  else
+  {
+    batchBody += ",";
+  }
+  batchBody += json;
+  batchRows++;
 
-    uint8_t bytesRead = stream->readBytes(buffer, bytesToRead);
+  if (batchRows >= batchMaxRows && !_batchBackingOff())
+  {
+    return flushBatch();
+  }
+  return checkBatch();
+}
 
-    client.write(buffer, bytesRead);
+// after a failed flush the automatic ones wait as the retry policy says
+bool Supabase::_batchBackingOff()
+{
+  return batchRetryAt != 0 && (long)(millis() - batchRetryAt) < 0;
+}
 
-    availableBytes = stream->available();
+// Sends every buffered row as a single PostgREST bulk insert. On failure the
+// rows are kept, so the next flush retries them.
+int Supabase::flushBatch()
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  if (batchRows == 0)
+  {
+    return 0;
   }
 
-  client.write((uint8_t *)endingHeader.c_str(), endingHeader.length());
-
-  bool firstLine = true;
+  batchBody += "]";
+  int httpCode = _write("POST", hostname + "/rest/v1/" + batchTable, batchBody, batchOptions, nullptr);
+  batchBody.remove(batchBody.length() - 1);
 
-  while (client.connected())
+  if (httpCode >= 200 && httpCode < 300)
   {
-    String line = client.readStringUntil('\n');
-    line.trim(); // remove \r
-
-    if (firstLine)
+    batchBody = "";
+    batchRows = 0;
+    batchRetryAt = 0;
+    batchFailures = 0;
+  }
+  else
+  {
+    if (batchFailures < 16)
     {
-      if (line == "")
-        continue;
-
-      int codePos = line.indexOf(' ') + 1;
-      httpCode = line.substring(codePos, line.indexOf(' ', codePos)).toInt();
-      firstLine = false;
-      Serial.printf("Return Code: %d\n\r", httpCode);
+      batchFailures++;
     }
-
-    Serial.printf("%s\n\r", line.c_str());
-
-    if (line == "")
+    unsigned long wait = _retry().backoff(batchFailures);
+    Serial.printf("Batch insert failed (%d), keeping %u rows, next try in %lu ms\n", httpCode, batchRows, wait);
+    batchRetryAt = millis() + wait;
+    if (batchRetryAt == 0)
     {
-      break;
+      batchRetryAt = 1;
     }
   }
+  return httpCode;
+}
 
-  String response = client.readStringUntil('\n');
-
-  Serial.printf("HTTP Response:\n\r");
-  Serial.printf("==========\n\r");
-  Serial.printf("%s\n\r", response.c_str());
-  Serial.printf("==========\n\r");
-  Serial.printf("HTTP End\n\r");
+// Flushes the batch when its oldest row is older than maxAge.
+// Call this from loop() so slow producers still get their rows sent.
+int Supabase::checkBatch()
+{
+  if (batchRows > 0 && !_batchBackingOff() && (batchRetryAt != 0 || millis() - batchStarted >= batchMaxAge))
+  {
+    return flushBatch();
+  }
+  return 0;
+}
 
-  Serial.printf("Return Code: %d\n\r", httpCode);
+uint16_t Supabase::batchCount()
+{
+  return batchRows;
+}
 
-  return httpCode;
+Supabase &Supabase::select(String colls)
+{
+  url_query += ("select=" + colls);
+  return *this;
+}
+Supabase &Supabase::update(String table)
+{
+  url_query += (table + "?");
+  return *this;
 }
 
 // Supabase& Supabase::drop(String table){
@@ -512,59 +766,197 @@ Supabase &Supabase::offset(int by)
 // do select. execute this after building your query
 String Supabase::doSelect()
 {
-  https.begin(client, hostname + "/rest/v1/" + url_query);
-  https.addHeader("apikey", key);
-  https.addHeader("Content-Type", "application/json");
-
-  if (useAuth)
+  String url = hostname + "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return _doSelect(url);
+}
+// same as doSelect() but with a query built by SupabaseQuery
+String Supabase::doSelect(const SupabaseQuery &query)
+{
+  if (query.overflow())
   {
-    unsigned long t_now = millis();
-    if (t_now - loginTime >= authTimeout)
-    {
-      _login_process();
-    }
-    https.addHeader("Authorization", "Bearer " + USER_TOKEN);
+    Serial.println("Query buffer overflow, select not sent");
+    return "";
   }
-
-  int httpCode = 0;
-  while (httpCode <= 0)
+  return _doSelect(hostname + "/rest/v1/" + query.c_str());
+}
+// streaming select, the result is deserialized straight from the connection
+int Supabase::doSelect(JsonDocument &doc, JsonDocument *filter)
+{
+  String url = hostname + "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return _parse("GET", url, "", doc, filter);
+}
+// streaming select, onRow is called for every row of the result array
+int Supabase::doSelectEach(SupabaseRowCallback onRow, JsonDocument *filter)
+{
+  String url = hostname + "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return _parseEach("GET", url, "", onRow, filter);
+}
+// HEAD of the select, only the headers are exchanged: a cheap existence or
+// reachability check. count ("exact", "planned" or "estimated") asks for the
+// number of matching rows, read from Content-Range (-1 if unknown).
+int Supabase::doHead()
+{
+  String path = "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return _head(path, "", nullptr);
+}
+int Supabase::doHead(const SupabaseQuery &query)
+{
+  if (query.overflow())
+  {
+    Serial.println("Query buffer overflow, select not sent");
+    return -101;
+  }
+  return _head(String("/rest/v1/") + query.c_str(), "", nullptr);
+}
+int Supabase::doCount(long &count, String method)
+{
+  String path = "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return _head(path, method, &count);
+}
+int Supabase::doCount(const SupabaseQuery &query, long &count, String method)
+{
+  if (query.overflow())
   {
-    httpCode = https.GET();
+    Serial.println("Query buffer overflow, select not sent");
+    return -101;
   }
+  return _head(String("/rest/v1/") + query.c_str(), method, &count);
+}
+int Supabase::_head(const String &path, const String &method, long *count)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabasePrepared request = prepare("HEAD", path, method.length() > 0 ? "count=" + method : "");
 
+  static const char *keys[] = {"content-range"};
+  String range;
+  SupabaseBodyStream body;
+  bool close = false;
+  int httpCode = _executeOpen(request, "", nullptr, body, close, keys, &range, 1);
   if (httpCode > 0)
   {
-    data = https.getString();
+    _rawEnd(close);
   }
-  https.end();
+
+  if (count)
+  {
+    // 0-24/3573, */0 when nothing matches, 0-24/* when the total is unknown
+    int slash = range.indexOf('/');
+    *count = slash >= 0 && range[slash + 1] != '*' ? atol(range.c_str() + slash + 1) : -1;
+  }
+  return httpCode;
+}
+
+// compact select, the result is requested as CSV and split into rows in buffer
+int Supabase::doSelectCsv(SupabaseCsvCallback onRow, char *buffer, size_t size)
+{
+  String url = hostname + "/rest/v1/" + url_query;
   urlQuery_reset();
-  return data;
+  return _selectCsv(url, onRow, buffer, size);
 }
-// do update. execute this after querying your update
-int Supabase::doUpdate(String json)
+int Supabase::doSelectCsv(const SupabaseQuery &query, SupabaseCsvCallback onRow, char *buffer, size_t size)
 {
-  int httpCode;
-  if (https.begin(client, hostname + "/rest/v1/" + url_query))
+  if (query.overflow())
   {
-    https.addHeader("apikey", key);
-    https.addHeader("Content-Type", "application/json");
-    if (useAuth)
+    Serial.println("Query buffer overflow, select not sent");
+    return -101;
+  }
+  return _selectCsv(hostname + "/rest/v1/" + query.c_str(), onRow, buffer, size);
+}
+int Supabase::_selectCsv(const String &url, SupabaseCsvCallback onRow, char *buffer, size_t size)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool gzip;
+  int httpCode = _openBody("GET", url, "", body, gzip, "text/csv");
+  if (httpCode <= 0)
+  {
+    return httpCode;
+  }
+
+  SupabaseCsvReader reader(_decoded(body, gzip), buffer, size);
+  if (httpCode >= 200 && httpCode < 300 && reader.header())
+  {
+    SupabaseCsvRow row;
+    while (reader.next(row))
     {
-      unsigned long t_now = millis();
-      if (t_now - loginTime >= authTimeout)
-      {
-        _login_process();
-      }
-      https.addHeader("Authorization", "Bearer " + USER_TOKEN);
+      onRow(row);
+    }
+    if (reader.skipped() > 0)
+    {
+      Serial.printf("%u rows didn't fit the CSV buffer\n", reader.skipped());
     }
-    httpCode = https.PATCH(json);
-    https.end();
   }
-  else
+
+  _closeBody(body);
+  return httpCode;
+}
+String Supabase::_doSelect(const String &url)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool gzip;
+  int httpCode = _openBody("GET", url, "", body, gzip);
+  if (httpCode <= 0)
   {
-    return -100;
+    data = "";
+    return data;
+  }
+
+  data = _decoded(body, gzip).readString();
+  _closeBody(body);
+  return data;
+}
+// do update. execute this after querying your update
+int Supabase::doUpdate(String json)
+{
+  String url = hostname + "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return _doUpdate(url, json);
+}
+// same as doUpdate() but with a query built by SupabaseQuery
+int Supabase::doUpdate(const SupabaseQuery &query, String json)
+{
+  if (query.overflow())
+  {
+    Serial.println("Query buffer overflow, update not sent");
+    return -101;
   }
+  return _doUpdate(hostname + "/rest/v1/" + query.c_str(), json);
+}
+int Supabase::doUpdate(String json, const SupabaseWriteOptions &options, String *response)
+{
+  String url = hostname + "/rest/v1/" + url_query;
   urlQuery_reset();
+  return _write("PATCH", url, json, options, response);
+}
+int Supabase::doUpdate(const SupabaseQuery &query, String json, const SupabaseWriteOptions &options, String *response)
+{
+  if (query.overflow())
+  {
+    Serial.println("Query buffer overflow, update not sent");
+    return -101;
+  }
+  return _write("PATCH", hostname + "/rest/v1/" + query.c_str(), json, options, response);
+}
+int Supabase::_doUpdate(const String &url, const String &json)
+{
+  return _write("PATCH", url, json, SupabaseWriteOptions(), nullptr);
+}
+
+// Logs in, retrying as the retry policy allows instead of forever
+int Supabase::_login_retry()
+{
+  int httpCode = _login_process();
+  for (uint8_t attempt = 1; SupabaseRetryPolicy::retryable(httpCode) && _retry().shouldRetry(attempt); attempt++)
+  {
+    delay(_retry().backoff(attempt));
+    httpCode = _login_process();
+  }
   return httpCode;
 }
 
@@ -575,12 +967,7 @@ int Supabase::login_email(String email_a, String password_a)
   phone_or_email = email_a;
   password = password_a;
 
-  int httpCode = 0;
-  while (httpCode <= 0)
-  {
-    httpCode = _login_process();
-  }
-  return httpCode;
+  return _login_retry();
 }
 
 int Supabase::login_phone(String phone_a, String password_a)
@@ -590,43 +977,31 @@ int Supabase::login_phone(String phone_a, String password_a)
   phone_or_email = phone_a;
   password = password_a;
 
-  int httpCode = 0;
-  while (httpCode <= 0)
-  {
-    httpCode = _login_process();
-  }
-  return httpCode;
+  return _login_retry();
 }
 
 String Supabase::rpc(String func_name, String json_param)
 {
-  int httpCode;
-
-  if (!https.begin(client, hostname + "/rest/v1/rpc/" + func_name))
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool gzip;
+  int httpCode = _openBody("POST", hostname + "/rest/v1/rpc/" + func_name, json_param, body, gzip);
+  if (httpCode <= 0)
   {
-    return String(-100);
+    return String(httpCode);
   }
-  https.addHeader("apikey", key);
-  https.addHeader("Content-Type", "application/json");
 
-  if (useAuth)
-  {
-    unsigned long t_now = millis();
-    if (t_now - loginTime >= authTimeout)
-    {
-      _login_process();
-    }
-    https.addHeader("Authorization", "Bearer " + USER_TOKEN);
-  }
+  data = _decoded(body, gzip).readString();
+  _closeBody(body);
+  return data;
+}
 
-  httpCode = https.POST(json_param);
-  if (httpCode > 0)
-  {
-    data = https.getString();
-    https.end();
-    return data;
-  }
+int Supabase::rpc(String func_name, String json_param, JsonDocument &doc, JsonDocument *filter)
+{
+  return _parse("POST", hostname + "/rest/v1/rpc/" + func_name, json_param, doc, filter);
+}
 
-  https.end();
-  return String(httpCode);
+int Supabase::rpcEach(String func_name, String json_param, SupabaseRowCallback onRow, JsonDocument *filter)
+{
+  return _parseEach("POST", hostname + "/rest/v1/rpc/" + func_name, json_param, onRow, filter);
 }
@@ -0,0 +1,701 @@
+#include "ESPSupabase.h"
+#include <utility>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+// bytes written to / read from the socket per step, keeps every step short
+static const size_t asyncSlice = 512;
+
+// token grants go out without the Authorization header, like _token_request()
+static bool isGrant(const SupabaseAsyncRequest &request)
+{
+  return request.path.startsWith("/auth/v1/token?");
+}
+
+bool Supabase::submit(const char *method, String path, String payload, SupabaseResponseCallback onDone, String prefer)
+{
+  return _asyncQueue(false, method, path, payload, onDone, prefer);
+}
+
+// Queues a request at the tail, or in front of the head when nothing is in flight
+bool Supabase::_asyncQueue(bool first, const char *method, const String &path, const String &payload, SupabaseResponseCallback onDone, const String &prefer)
+{
+  if (asyncCount >= SUPABASE_ASYNC_QUEUE)
+  {
+    return false;
+  }
+
+  if (first)
+  {
+    asyncHead = (asyncHead + SUPABASE_ASYNC_QUEUE - 1) % SUPABASE_ASYNC_QUEUE;
+  }
+  SupabaseAsyncRequest &request = asyncQueue[(asyncHead + (first ? 0 : asyncCount)) % SUPABASE_ASYNC_QUEUE];
+  request.method = method;
+  request.path = path;
+  request.payload = payload;
+  request.prefer = prefer;
+  request.onDone = onDone;
+  request.attempts = 0;
+  request.lost = false;
+  asyncCount++;
+  return true;
+}
+
+bool Supabase::submitSelect(SupabaseResponseCallback onDone)
+{
+  String path = "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return submit("GET", path, "", onDone);
+}
+
+bool Supabase::submitInsert(String table, String json, SupabaseResponseCallback onDone)
+{
+  return submit("POST", "/rest/v1/" + table, json, onDone, "return=representation");
+}
+
+bool Supabase::submitUpdate(String json, SupabaseResponseCallback onDone)
+{
+  String path = "/rest/v1/" + url_query;
+  urlQuery_reset();
+  return submit("PATCH", path, json, onDone);
+}
+
+bool Supabase::submitRpc(String func_name, String json_param, SupabaseResponseCallback onDone)
+{
+  return submit("POST", "/rest/v1/rpc/" + func_name, json_param, onDone);
+}
+
+bool Supabase::busy()
+{
+  return asyncCount > 0;
+}
+
+void Supabase::setPollBudget(unsigned long budget, unsigned long timeout)
+{
+  asyncBudget = budget;
+  asyncTimeout = timeout;
+}
+
+void Supabase::setPipeline(uint8_t depth)
+{
+  if (depth < 1)
+  {
+    depth = 1;
+  }
+  if (depth > SUPABASE_ASYNC_QUEUE)
+  {
+    depth = SUPABASE_ASYNC_QUEUE;
+  }
+  asyncDepth = depth;
+}
+
+// Advances the queued requests until there is nothing to do right now or
+// the time budget is used up
+void Supabase::poll()
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  _asyncRenew();
+
+  unsigned long start = millis();
+  while (asyncCount > 0 && _asyncStep())
+  {
+    if (millis() - start >= asyncBudget)
+    {
+      break;
+    }
+  }
+}
+
+// Queues a refresh_token grant ahead of the token expiry, so requests never
+// have to wait for a login
+void Supabase::_asyncRenew()
+{
+  if (!useAuth || asyncRenewing || session.refreshToken.length() == 0 || !session.needsRenewal())
+  {
+    return;
+  }
+  if (asyncRenewAt != 0 && (long)(millis() - asyncRenewAt) < 0)
+  {
+    return;
+  }
+  asyncRenewing = _asyncGrant(false);
+}
+
+// Gets a token before the request at the head goes out when it already
+// expired (the renewal failed, or the device slept through it), by moving the
+// queued grant in front of it or queueing one there. false while renewals
+// back off or the queue is full, the request then goes out as it is.
+bool Supabase::_asyncRenewFirst()
+{
+  if (asyncRenewing)
+  {
+    for (uint8_t i = 1; i < asyncCount; i++)
+    {
+      if (isGrant(asyncQueue[(asyncHead + i) % SUPABASE_ASYNC_QUEUE]))
+      {
+        for (uint8_t j = i; j > 0; j--)
+        {
+          std::swap(asyncQueue[(asyncHead + j) % SUPABASE_ASYNC_QUEUE], asyncQueue[(asyncHead + j - 1) % SUPABASE_ASYNC_QUEUE]);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+  if (asyncRenewAt != 0 && (long)(millis() - asyncRenewAt) < 0)
+  {
+    return false;
+  }
+  asyncRenewing = _asyncGrant(true);
+  return asyncRenewing;
+}
+
+// Queues the refresh_token grant, or a login when there is no refresh token
+bool Supabase::_asyncGrant(bool first)
+{
+  String path = "/auth/v1/token?grant_type=";
+  String body;
+  if (session.refreshToken.length() > 0)
+  {
+    path += "refresh_token";
+    body = "{\"refresh_token\": \"" + session.refreshToken + "\"}";
+  }
+  else
+  {
+    path += "password";
+    body = "{\"" + loginMethod + "\": \"" + phone_or_email + "\", \"password\": \"" + password + "\"}";
+  }
+
+  return _asyncQueue(first, "POST", path, body, [this](int httpCode, String &response)
+  {
+    asyncRenewing = false;
+
+    JsonDocument doc;
+    if (httpCode == 200 && !deserializeJson(doc, response) && session.update(doc))
+    {
+      USER_TOKEN = session.accessToken;
+      asyncRenewAt = 0;
+      renewAttempts = 0;
+      return;
+    }
+
+    Serial.printf("Session refresh failed (%d)\n", httpCode);
+    if (renewAttempts < 16)
+    {
+      renewAttempts++;
+    }
+    asyncRenewAt = millis() + _retry().backoff(renewAttempts);
+    if (asyncRenewAt == 0)
+    {
+      asyncRenewAt = 1;
+    }
+  }, "");
+}
+
+// One step of the state machine, returns false when it has to wait for the network
+bool Supabase::_asyncStep()
+{
+  switch (asyncState)
+  {
+  case ASYNC_IDLE:
+    if (asyncRetryAt != 0)
+    {
+      // backing off before the next attempt
+      if ((long)(millis() - asyncRetryAt) < 0)
+      {
+        return false;
+      }
+      asyncRetryAt = 0;
+    }
+    _asyncStart();
+    return true;
+
+  case ASYNC_RESOLVE:
+  {
+    // separate step so the DNS lookup and the handshake never add up in one poll()
+    bool resolved = WiFi.hostByName(host.c_str(), asyncIp);
+    if (metrics)
+    {
+      asyncTimer.mark(SupabaseMetrics::DNS);
+    }
+    if (!resolved)
+    {
+      _asyncFinish(HTTPC_ERROR_CONNECTION_REFUSED);
+      return false;
+    }
+    asyncState = ASYNC_CONNECT;
+    return true;
+  }
+
+  case ASYNC_CONNECT:
+    // The TLS handshake can't be split on the ESP cores, it is the only step
+    // that blocks for longer. With keep-alive it only happens once.
+#if defined(ESP8266)
+    // BearSSL only sends SNI when connecting by name, lwIP answers the
+    // lookup from the cache the resolve step just filled
+    if (!client.connect(host.c_str(), 443))
+#else
+    if (!client.connect(asyncIp, 443, host.c_str(), nullptr, nullptr, nullptr))
+#endif
+    {
+      _asyncFinish(HTTPC_ERROR_CONNECTION_REFUSED);
+      return false;
+    }
+    if (metrics)
+    {
+      asyncTimer.mark(SupabaseMetrics::CONNECT);
+    }
+    connectionStats.opened++;
+    asyncSince = millis();
+    asyncState = ASYNC_SEND;
+    return true;
+
+  case ASYNC_SEND:
+  {
+    size_t size = asyncOut.length() - asyncOutSent;
+    if (size > asyncSlice)
+    {
+      size = asyncSlice;
+    }
+
+    size_t written = client.write((const uint8_t *)asyncOut.c_str() + asyncOutSent, size);
+    if (written == 0)
+    {
+      if (!_asyncRetry())
+      {
+        _asyncFinish(HTTPC_ERROR_SEND_HEADER_FAILED);
+      }
+      return false;
+    }
+
+    asyncOutSent += written;
+    asyncSince = millis();
+    if (asyncOutSent >= asyncOut.length())
+    {
+      if (metrics && asyncSent == 0)
+      {
+        asyncTimer.bytes(asyncOut.length(), 0);
+      }
+      asyncSent++;
+      if (!_asyncPipelineNext())
+      {
+        if (metrics)
+        {
+          asyncTimer.mark(SupabaseMetrics::SEND);
+        }
+        _asyncExpect();
+        asyncState = ASYNC_STATUS;
+      }
+    }
+    return true;
+  }
+
+  case ASYNC_STATUS:
+  case ASYNC_HEADERS:
+    if (_asyncReadHead())
+    {
+      asyncSince = millis();
+      return true;
+    }
+    break;
+
+  case ASYNC_BODY:
+  {
+    size_t n = 0;
+    while (n < asyncSlice && asyncBodyStream.available() > 0)
+    {
+      int c = asyncBodyStream.read();
+      if (c < 0)
+      {
+        break;
+      }
+      asyncBody += (char)c;
+      n++;
+    }
+
+    if (asyncBodyStream.finished())
+    {
+      _asyncFinish(asyncCode);
+      return true;
+    }
+    if (n > 0)
+    {
+      asyncSince = millis();
+      return true;
+    }
+    break;
+  }
+  }
+
+  // waiting for the server
+  if (!client.connected() && client.available() == 0)
+  {
+    if (asyncState == ASYNC_BODY && asyncLength < 0 && !asyncChunked)
+    {
+      // body delimited by the connection close
+      asyncClose = true;
+      _asyncFinish(asyncCode);
+    }
+    else if (!_asyncRetry())
+    {
+      _asyncFinish(HTTPC_ERROR_CONNECTION_LOST);
+    }
+  }
+  else if (millis() - asyncSince >= asyncTimeout)
+  {
+    _asyncFinish(HTTPC_ERROR_READ_TIMEOUT);
+  }
+  return false;
+}
+
+// Starts the request at the head of the queue
+void Supabase::_asyncStart()
+{
+  SupabaseAsyncRequest &request = asyncQueue[asyncHead];
+  if (request.lost)
+  {
+    // it may or may not have been processed, not safe to send again
+    _asyncFinish(HTTPC_ERROR_CONNECTION_LOST);
+    return;
+  }
+
+  if (useAuth && session.expired() && !isGrant(request) && _asyncRenewFirst())
+  {
+    // the grant is the head now, the next step starts it
+    return;
+  }
+
+  _asyncSerialize(request);
+  request.attempts++;
+  asyncSent = 0;
+  if (metrics)
+  {
+    asyncTimer.begin(*metrics, request.path.c_str());
+  }
+
+  if (client.connected() && keepAlive && millis() - lastActivity >= keepAliveIdleTimeout)
+  {
+    client.stop();
+    connectionStats.idleCloses++;
+  }
+
+  asyncReused = client.connected();
+  if (asyncReused)
+  {
+    connectionStats.reused++;
+    if (metrics)
+    {
+      asyncTimer.reused(true);
+    }
+    asyncState = ASYNC_SEND;
+  }
+  else
+  {
+    asyncState = ASYNC_RESOLVE;
+  }
+}
+
+void Supabase::_asyncSerialize(SupabaseAsyncRequest &request)
+{
+  bool hasBody = request.payload.length() > 0 || (strcmp(request.method, "GET") != 0 && strcmp(request.method, "HEAD") != 0);
+
+  asyncOut = "";
+  asyncOut.reserve(200 + request.path.length() + host.length() + key.length() + USER_TOKEN.length() + request.prefer.length() + request.payload.length());
+  asyncOut += request.method;
+  asyncOut += " ";
+  asyncOut += request.path;
+  asyncOut += " HTTP/1.1\r\nHost: ";
+  asyncOut += host;
+  asyncOut += "\r\napikey: ";
+  asyncOut += key;
+  asyncOut += "\r\n";
+  if (useAuth && !isGrant(request))
+  {
+    asyncOut += "Authorization: Bearer ";
+    asyncOut += USER_TOKEN;
+    asyncOut += "\r\n";
+  }
+  if (request.prefer.length() > 0)
+  {
+    asyncOut += "Prefer: ";
+    asyncOut += request.prefer;
+    asyncOut += "\r\n";
+  }
+  if (hasBody)
+  {
+    asyncOut += "Content-Type: application/json\r\nContent-Length: ";
+    asyncOut += request.payload.length();
+    asyncOut += "\r\n";
+  }
+  asyncOut += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+  asyncOut += request.payload;
+  asyncOutSent = 0;
+  asyncSince = millis();
+}
+
+// Serializes the next queued request to be written right behind the ones
+// already sent, false when the window is full or it has to wait
+bool Supabase::_asyncPipelineNext()
+{
+  if (!keepAlive || asyncSent >= asyncDepth || asyncSent >= asyncCount)
+  {
+    return false;
+  }
+
+  // Nothing goes behind a POST or PATCH (RFC 7230 6.3.2): if the connection
+  // breaks before its response, it can't be told whether it was processed.
+  SupabaseAsyncRequest &previous = asyncQueue[(asyncHead + asyncSent - 1) % SUPABASE_ASYNC_QUEUE];
+  SupabaseAsyncRequest &request = asyncQueue[(asyncHead + asyncSent) % SUPABASE_ASYNC_QUEUE];
+  if (!SupabaseRetryPolicy::idempotent(previous.method) || request.lost)
+  {
+    return false;
+  }
+
+  _asyncSerialize(request);
+  request.attempts++;
+  connectionStats.pipelined++;
+  return true;
+}
+
+// Gets ready to read the response of the request at the head of the queue
+void Supabase::_asyncExpect()
+{
+  asyncLine = "";
+  asyncCode = 0;
+  asyncLength = -1;
+  asyncChunked = false;
+  asyncClose = !keepAlive;
+  asyncBody = "";
+  asyncSince = millis();
+}
+
+// The connection ended with count pipelined requests still waiting behind
+// the head. They stay queued and are sent again on the next connection,
+// unless the server may have processed them: a POST or PATCH is then failed with
+// HTTPC_ERROR_CONNECTION_LOST once it reaches the head. unprocessed is true
+// when the server closed on purpose (Connection: close), it doesn't process
+// anything it received after that response.
+void Supabase::_asyncRewind(uint8_t count, bool unprocessed)
+{
+  for (uint8_t i = 1; i <= count; i++)
+  {
+    SupabaseAsyncRequest &request = asyncQueue[(asyncHead + i) % SUPABASE_ASYNC_QUEUE];
+    if (!unprocessed && !SupabaseRetryPolicy::idempotent(request.method))
+    {
+      request.lost = true;
+    }
+  }
+}
+
+// Reads status line and headers as far as they arrived, false if nothing was read
+bool Supabase::_asyncReadHead()
+{
+  bool progress = false;
+  while (client.available() > 0 && (asyncState == ASYNC_STATUS || asyncState == ASYNC_HEADERS))
+  {
+    int c = client.read();
+    if (c < 0)
+    {
+      break;
+    }
+    progress = true;
+
+    if (c == '\r')
+    {
+      continue;
+    }
+    if (c != '\n')
+    {
+      asyncLine += (char)c;
+      continue;
+    }
+
+    if (asyncState == ASYNC_STATUS)
+    {
+      // HTTP/1.1 200 OK
+      if (asyncLine.length() > 0)
+      {
+        int codePos = asyncLine.indexOf(' ') + 1;
+        asyncCode = asyncLine.substring(codePos, codePos + 3).toInt();
+        asyncState = ASYNC_HEADERS;
+      }
+    }
+    else if (asyncLine.length() > 0)
+    {
+      _asyncHeader(asyncLine);
+    }
+    else if (asyncCode >= 100 && asyncCode < 200)
+    {
+      // interim response, the real one follows
+      asyncState = ASYNC_STATUS;
+    }
+    else
+    {
+      SupabaseAsyncRequest &request = asyncQueue[asyncHead];
+      bool noBody = strcmp(request.method, "HEAD") == 0 || asyncCode == 204 || asyncCode == 304;
+      if (metrics)
+      {
+        asyncTimer.response(asyncCode);
+      }
+      if (!noBody && asyncLength > 0)
+      {
+        asyncBody.reserve(asyncLength);
+      }
+      asyncBodyStream.begin(client, noBody ? 0 : asyncLength, !noBody && asyncChunked);
+      asyncState = ASYNC_BODY;
+    }
+    asyncLine = "";
+  }
+  return progress;
+}
+
+void Supabase::_asyncHeader(String &line)
+{
+  int colon = line.indexOf(':');
+  if (colon <= 0)
+  {
+    return;
+  }
+
+  String name = line.substring(0, colon);
+  String value = line.substring(colon + 1);
+  name.toLowerCase();
+  value.trim();
+
+  if (name == "content-length")
+  {
+    asyncLength = value.toInt();
+  }
+  else if (name == "transfer-encoding")
+  {
+    asyncChunked = value.equalsIgnoreCase("chunked");
+  }
+  else if (name == "connection")
+  {
+    asyncClose = value.equalsIgnoreCase("close");
+  }
+}
+
+// A kept-alive connection the server closed while we were idle fails before
+// any response byte arrives. The request was never processed, send it again
+// on a new connection.
+bool Supabase::_asyncRetry()
+{
+  if (!asyncReused || asyncState == ASYNC_HEADERS || asyncState == ASYNC_BODY || asyncLine.length() > 0)
+  {
+    return false;
+  }
+
+  client.stop();
+  connectionStats.reconnects++;
+  asyncReused = false;
+  // nothing of the batch reached the server, it is written again from the head
+  asyncSent = 0;
+  _asyncSerialize(asyncQueue[asyncHead]);
+  asyncState = ASYNC_RESOLVE;
+  return true;
+}
+
+void Supabase::_asyncFinish(int httpCode)
+{
+  SupabaseAsyncRequest &request = asyncQueue[asyncHead];
+
+  if (metrics)
+  {
+    if (httpCode <= 0)
+    {
+      asyncTimer.response(httpCode);
+    }
+    asyncTimer.bytes(0, asyncState == ASYNC_BODY ? asyncBodyStream.bytesRead() : 0);
+    asyncTimer.end();
+  }
+
+  // pipelined requests behind this one, still waiting for their response
+  uint8_t followers = asyncSent > 1 ? asyncSent - 1 : 0;
+  asyncSent = 0;
+  // a lost request was never written on this connection, it stays open
+  if ((httpCode <= 0 && !request.lost) || asyncClose)
+  {
+    client.stop();
+    _asyncRewind(followers, httpCode > 0);
+    followers = 0;
+  }
+
+  // POST and PATCH are only sent again when they never reached the server
+  bool idempotent = SupabaseRetryPolicy::idempotent(request.method);
+  bool retry = idempotent ? SupabaseRetryPolicy::retryable(httpCode) : httpCode == HTTPC_ERROR_CONNECTION_REFUSED;
+  if (retry && _retry().shouldRetry(request.attempts))
+  {
+    asyncOut = String();
+    asyncBody = String();
+    asyncRetryAt = millis() + _retry().backoff(request.attempts);
+    if (asyncRetryAt == 0)
+    {
+      asyncRetryAt = 1;
+    }
+
+    if (followers == 0)
+    {
+      asyncState = ASYNC_IDLE;
+      return;
+    }
+
+    // the responses behind it are already on the way, it goes to the back
+    // of the queue and is retried after them
+    uint8_t tail = (asyncHead + asyncCount) % SUPABASE_ASYNC_QUEUE;
+    if (tail != asyncHead)
+    {
+      asyncQueue[tail] = request;
+      request.path = String();
+      request.payload = String();
+      request.prefer = String();
+      request.onDone = nullptr;
+    }
+    asyncHead = (asyncHead + 1) % SUPABASE_ASYNC_QUEUE;
+    _asyncNextResponse(followers);
+    return;
+  }
+
+  SupabaseResponseCallback onDone = request.onDone;
+
+  request.path = String();
+  request.payload = String();
+  request.prefer = String();
+  request.onDone = nullptr;
+  asyncOut = String();
+  asyncHead = (asyncHead + 1) % SUPABASE_ASYNC_QUEUE;
+  asyncCount--;
+  lastActivity = millis();
+
+  asyncState = ASYNC_IDLE;
+
+  if (onDone)
+  {
+    onDone(httpCode, asyncBody);
+  }
+  asyncBody = String();
+
+  if (followers > 0)
+  {
+    _asyncNextResponse(followers);
+  }
+}
+
+// The response of the next pipelined request is already on the way
+void Supabase::_asyncNextResponse(uint8_t followers)
+{
+  asyncSent = followers;
+  asyncReused = false;
+  if (metrics)
+  {
+    // only its wait for the response and the body can be told apart
+    asyncTimer.begin(*metrics, asyncQueue[asyncHead].path.c_str());
+    asyncTimer.reused(true);
+  }
+  _asyncExpect();
+  asyncState = ASYNC_STATUS;
+}
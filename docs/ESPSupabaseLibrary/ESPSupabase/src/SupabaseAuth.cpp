@@ -0,0 +1,127 @@
+#include "SupabaseAuth.h"
+#include <time.h>
+
+// any clock before this has not been set by NTP yet
+static const time_t clockValidAfter = 1600000000;
+
+static int8_t base64urlValue(char c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '-' || c == '+')
+    return 62;
+  if (c == '_' || c == '/')
+    return 63;
+  return -1;
+}
+
+long SupabaseSession::jwtClaim(const String &jwt, const char *claim)
+{
+  int start = jwt.indexOf('.') + 1;
+  int end = jwt.indexOf('.', start);
+  if (start <= 0 || end < 0)
+  {
+    return 0;
+  }
+
+  // base64url decode the payload (middle) part
+  String payload;
+  payload.reserve((end - start) * 3 / 4 + 1);
+  uint32_t bits = 0;
+  uint8_t count = 0;
+  for (int i = start; i < end; i++)
+  {
+    int8_t value = base64urlValue(jwt[i]);
+    if (value < 0)
+    {
+      break;
+    }
+    bits = (bits << 6) | value;
+    count += 6;
+    if (count >= 8)
+    {
+      count -= 8;
+      payload += (char)((bits >> count) & 0xFF);
+    }
+  }
+
+  JsonDocument filter;
+  filter[claim] = true;
+  JsonDocument doc;
+  if (deserializeJson(doc, payload, DeserializationOption::Filter(filter)))
+  {
+    return 0;
+  }
+  return doc[claim].as<long>();
+}
+
+bool SupabaseSession::update(JsonDocument &response)
+{
+  if (!response["access_token"].is<String>() || response["access_token"].as<String>().isEmpty())
+  {
+    return false;
+  }
+
+  accessToken = response["access_token"].as<String>();
+  if (response["refresh_token"].is<String>())
+  {
+    refreshToken = response["refresh_token"].as<String>();
+  }
+  receivedAt = millis();
+
+  expiresAt = jwtClaim(accessToken, "exp");
+  long issuedAt = jwtClaim(accessToken, "iat");
+  if (expiresAt > 0 && issuedAt > 0 && expiresAt > issuedAt)
+  {
+    lifetime = expiresAt - issuedAt;
+  }
+  else
+  {
+    // not a JWT we can read, fall back to what the server told us
+    lifetime = response["expires_in"].as<long>();
+    expiresAt = 0;
+  }
+  return true;
+}
+
+void SupabaseSession::clear()
+{
+  accessToken = "";
+  refreshToken = "";
+  expiresAt = 0;
+  lifetime = 0;
+}
+
+long SupabaseSession::secondsLeft()
+{
+  if (accessToken.length() == 0)
+  {
+    return 0;
+  }
+
+  time_t now = time(nullptr);
+  if (expiresAt > 0 && now > clockValidAfter)
+  {
+    return expiresAt - (long)now;
+  }
+  return lifetime - (long)((millis() - receivedAt) / 1000);
+}
+
+bool SupabaseSession::expired()
+{
+  return secondsLeft() <= 0;
+}
+
+bool SupabaseSession::needsRenewal()
+{
+  long margin = lifetime / 6;
+  if (margin > 300)
+  {
+    margin = 300;
+  }
+  return secondsLeft() <= margin;
+}
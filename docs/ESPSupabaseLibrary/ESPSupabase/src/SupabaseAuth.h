@@ -0,0 +1,31 @@
+#ifndef ESP_Supabase_Auth_h
+#define ESP_Supabase_Auth_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Access and refresh token of a logged in user. The expiry comes from the
+// JWT exp claim: against the system clock once it is set (NTP), otherwise
+// as exp - iat counted from the moment the token arrived.
+struct SupabaseSession
+{
+  String accessToken;
+  String refreshToken;
+  long expiresAt = 0;           // exp claim, unix time in seconds
+  long lifetime = 0;            // exp - iat in seconds
+  unsigned long receivedAt = 0; // millis() when the token arrived
+
+  // reads a /auth/v1/token response, false if it holds no access token
+  bool update(JsonDocument &response);
+  void clear();
+
+  long secondsLeft();
+  bool expired();
+  // true once less than a sixth of the lifetime (at most 5 minutes) is left
+  bool needsRenewal();
+
+  // reads a numeric claim from the JWT payload, 0 if missing
+  static long jwtClaim(const String &jwt, const char *claim);
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "SupabaseCsv.h"
+
+uint8_t SupabaseCsvRow::columns() const
+{
+  return count;
+}
+
+const char *SupabaseCsvRow::name(uint8_t i) const
+{
+  return i < nameCount ? names[i] : "";
+}
+
+int SupabaseCsvRow::index(const char *name) const
+{
+  for (uint8_t i = 0; i < nameCount; i++)
+  {
+    if (strcmp(names[i], name) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char *SupabaseCsvRow::text(uint8_t i) const
+{
+  return i < count ? fields[i] : "";
+}
+
+bool SupabaseCsvRow::isNull(uint8_t i) const
+{
+  return text(i)[0] == '\0';
+}
+
+long SupabaseCsvRow::toInt(uint8_t i) const
+{
+  return strtol(text(i), nullptr, 10);
+}
+
+double SupabaseCsvRow::toDouble(uint8_t i) const
+{
+  return strtod(text(i), nullptr);
+}
+
+bool SupabaseCsvRow::toBool(uint8_t i) const
+{
+  const char *value = text(i);
+  return strcmp(value, "t") == 0 || strcmp(value, "true") == 0;
+}
+
+SupabaseCsvReader::SupabaseCsvReader(Stream &in_a, char *buffer_a, size_t size_a)
+    : in(in_a), buffer(buffer_a), size(size_a)
+{
+}
+
+// Reads one row into start. Returns the bytes it used, -1 at the end of the
+// input, -2 if the row didn't fit (it is read to its end anyway).
+int SupabaseCsvReader::_row(char *start, size_t room, char **fields, uint8_t &count)
+{
+  char *w = start;
+  char *end = start + room - 1; // room for the last '\0'
+  bool quoted = false;
+  bool quoteSeen = false; // a '"' inside quotes, either the closing one or the first of ""
+  bool any = false;
+  bool overflow = room == 0;
+
+  count = 0;
+  if (!overflow)
+  {
+    fields[count++] = w;
+  }
+
+  while (true)
+  {
+    char c;
+    if (in.readBytes(&c, 1) != 1)
+    {
+      if (!any)
+      {
+        return -1;
+      }
+      break;
+    }
+    any = true;
+
+    if (quoted)
+    {
+      if (quoteSeen)
+      {
+        quoteSeen = false;
+        if (c != '"')
+        {
+          // that was the closing quote
+          quoted = false;
+        }
+      }
+      else if (c == '"')
+      {
+        quoteSeen = true;
+        continue;
+      }
+    }
+
+    if (!quoted)
+    {
+      if (c == '"' && !overflow && w == fields[count - 1])
+      {
+        quoted = true;
+        continue;
+      }
+      if (c == '\r')
+      {
+        continue;
+      }
+      if (c == '\n')
+      {
+        break;
+      }
+      if (c == ',')
+      {
+        if (overflow || w >= end || count >= SUPABASE_CSV_COLUMNS)
+        {
+          overflow = true;
+          continue;
+        }
+        *w++ = '\0';
+        fields[count++] = w;
+        continue;
+      }
+    }
+
+    if (overflow || w >= end)
+    {
+      overflow = true;
+      continue;
+    }
+    *w++ = c;
+  }
+
+  if (overflow)
+  {
+    return -2;
+  }
+  *w++ = '\0';
+  return w - start;
+}
+
+bool SupabaseCsvReader::header()
+{
+  int used;
+  do
+  {
+    used = _row(buffer, size, names, nameCount);
+  } while (used == 1 && names[0][0] == '\0'); // blank lines
+
+  if (used < 0)
+  {
+    nameCount = 0;
+    return false;
+  }
+  headerUsed = used;
+  return true;
+}
+
+bool SupabaseCsvReader::next(SupabaseCsvRow &row)
+{
+  row.names = names;
+  row.nameCount = nameCount;
+  while (true)
+  {
+    int used = _row(buffer + headerUsed, size - headerUsed, row.fields, row.count);
+    if (used == -1)
+    {
+      row.count = 0;
+      return false;
+    }
+    if (used == -2)
+    {
+      skippedRows++;
+      continue;
+    }
+    if (used == 1 && row.fields[0][0] == '\0')
+    {
+      // blank line, e.g. at the end of the response
+      continue;
+    }
+    return true;
+  }
+}
+
+uint32_t SupabaseCsvReader::skipped()
+{
+  return skippedRows;
+}
@@ -0,0 +1,66 @@
+#ifndef ESP_Supabase_Csv_h
+#define ESP_Supabase_Csv_h
+
+#include <Arduino.h>
+
+#ifndef SUPABASE_CSV_COLUMNS
+#define SUPABASE_CSV_COLUMNS 16
+#endif
+
+// One row of a CSV response. The fields point into the reader's buffer and
+// are only valid inside the row callback.
+class SupabaseCsvRow
+{
+private:
+  friend class SupabaseCsvReader;
+  char *fields[SUPABASE_CSV_COLUMNS];
+  char *const *names = nullptr;
+  uint8_t count = 0;
+  uint8_t nameCount = 0;
+
+public:
+  uint8_t columns() const;
+  // column name from the header row
+  const char *name(uint8_t i) const;
+  // index of the column called name, -1 if there is none
+  int index(const char *name) const;
+
+  // "" for columns past the end of the row
+  const char *text(uint8_t i) const;
+  // PostgREST writes NULL as an empty field
+  bool isNull(uint8_t i) const;
+  long toInt(uint8_t i) const;
+  double toDouble(uint8_t i) const;
+  // "t" or "true"
+  bool toBool(uint8_t i) const;
+};
+
+// Splits CSV (RFC 4180) read from a Stream into rows, in place: quotes are
+// removed and separators replaced by '\0' inside the given buffer, nothing
+// is allocated. The header row stays at the start of the buffer, the rows
+// are read into the rest of it.
+class SupabaseCsvReader
+{
+private:
+  Stream &in;
+  char *buffer;
+  size_t size;
+  size_t headerUsed = 0;
+  char *names[SUPABASE_CSV_COLUMNS];
+  uint8_t nameCount = 0;
+  uint32_t skippedRows = 0;
+
+  int _row(char *start, size_t room, char **fields, uint8_t &count);
+
+public:
+  SupabaseCsvReader(Stream &in_a, char *buffer_a, size_t size_a);
+
+  // reads the header row, false if the response is empty or it doesn't fit
+  bool header();
+  // reads the next row, false at the end. Rows that don't fit are skipped.
+  bool next(SupabaseCsvRow &row);
+  // rows skipped because they didn't fit the buffer
+  uint32_t skipped();
+};
+
+#endif
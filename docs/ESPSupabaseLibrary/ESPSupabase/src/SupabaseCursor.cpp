@@ -0,0 +1,89 @@
+#include "ESPSupabase.h"
+
+SupabaseCursor::SupabaseCursor(Supabase &db_a, const String &query_a, const String &key_a, uint16_t pageSize_a)
+    : db(db_a), query(query_a), key(key_a), pageSize(pageSize_a > 0 ? pageSize_a : 1)
+{
+}
+
+SupabaseCursor Supabase::cursor(String key, uint16_t pageSize)
+{
+  String query = url_query;
+  urlQuery_reset();
+  return SupabaseCursor(*this, query, key, pageSize);
+}
+
+SupabaseCursor Supabase::cursor(const SupabaseQuery &query, String key, uint16_t pageSize)
+{
+  if (query.overflow())
+  {
+    Serial.println("Query buffer overflow, cursor is empty");
+    SupabaseCursor empty(*this, "", key, pageSize);
+    empty.end = true;
+    return empty;
+  }
+  return SupabaseCursor(*this, query.c_str(), key, pageSize);
+}
+
+int SupabaseCursor::next(SupabaseRowCallback onRow, JsonDocument *filter)
+{
+  if (end)
+  {
+    return 0;
+  }
+
+  String url = db.hostname + "/rest/v1/" + query;
+  if (!url.endsWith("?") && !url.endsWith("&"))
+  {
+    url += query.indexOf('?') >= 0 ? "&" : "?";
+  }
+  if (last.length() > 0)
+  {
+    url += key + "=gt.";
+    for (unsigned int i = 0; i < last.length(); i++)
+    {
+      // timestamps carry a + in their offset, which would read as a space
+      if (last[i] == '+')
+        url += "%2B";
+      else
+        url += last[i];
+    }
+    url += "&";
+  }
+  url += "order=" + key + ".asc&limit=" + String(pageSize);
+
+  if (filter)
+  {
+    // the key is needed to ask for the next page
+    (*filter)[key] = true;
+  }
+
+  uint16_t rows = 0;
+  int httpCode = db._parseEach("GET", url, "", [&](JsonObjectConst row)
+  {
+    rows++;
+    last = row[key].as<String>();
+    onRow(row);
+  }, filter);
+
+  if (httpCode >= 200 && httpCode < 300 && rows < pageSize)
+  {
+    end = true;
+  }
+  return httpCode;
+}
+
+bool SupabaseCursor::done()
+{
+  return end;
+}
+
+String SupabaseCursor::lastKey()
+{
+  return last;
+}
+
+void SupabaseCursor::resume(String lastKey)
+{
+  last = lastKey;
+  end = false;
+}
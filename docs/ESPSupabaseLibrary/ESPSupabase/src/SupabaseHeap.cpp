@@ -0,0 +1,174 @@
+#include "SupabaseHeap.h"
+
+bool SupabaseHeap::on = false;
+bool SupabaseHeap::counting = false;
+SupabaseHeapStats SupabaseHeap::all[SupabaseHeap::SUBSYSTEMS];
+SupabaseHeapScope *SupabaseHeap::top = nullptr;
+
+void SupabaseHeap::begin(bool counting_a)
+{
+  counting = counting_a;
+  on = true;
+}
+
+void SupabaseHeap::end()
+{
+  on = false;
+}
+
+bool SupabaseHeap::enabled()
+{
+  return on;
+}
+
+void SupabaseHeap::reset()
+{
+  for (uint8_t i = 0; i < SUBSYSTEMS; i++)
+  {
+    all[i] = SupabaseHeapStats();
+  }
+}
+
+const char *SupabaseHeap::name(uint8_t subsystem)
+{
+  static const char *names[] = {"rest", "realtime", "websocket"};
+  return subsystem < SUBSYSTEMS ? names[subsystem] : "";
+}
+
+const SupabaseHeapStats &SupabaseHeap::stats(uint8_t subsystem)
+{
+  return all[subsystem < SUBSYSTEMS ? subsystem : REST];
+}
+
+uint8_t SupabaseHeap::current()
+{
+  return top ? top->subsystem : NONE;
+}
+
+size_t SupabaseHeap::printTo(Print &out)
+{
+  size_t n = 0;
+  char line[120];
+  int length;
+  for (uint8_t i = 0; i < SUBSYSTEMS; i++)
+  {
+    const SupabaseHeapStats &s = all[i];
+    if (s.calls == 0 && s.allocations == 0)
+    {
+      continue;
+    }
+    if (counting)
+    {
+      length = snprintf(line, sizeof(line), "%s%s live=%d peak=%d alloc=%u free=%u n=%u",
+                        n > 0 ? " | " : "heap ", name(i), (int)s.live, (int)s.peak,
+                        (unsigned)s.allocations, (unsigned)s.frees, (unsigned)s.calls);
+    }
+    else
+    {
+      length = snprintf(line, sizeof(line), "%s%s live=%d peak=%d n=%u",
+                        n > 0 ? " | " : "heap ", name(i), (int)s.live, (int)s.peak, (unsigned)s.calls);
+    }
+    if (length > 0)
+    {
+      n += out.write((const uint8_t *)line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+    }
+  }
+
+  length = snprintf(line, sizeof(line), "%sfree=%u block=%u", n > 0 ? " | " : "heap ", (unsigned)freeHeap(), (unsigned)largestBlock());
+  if (length > 0)
+  {
+    n += out.write((const uint8_t *)line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+  }
+  n += out.println();
+  return n;
+}
+
+uint8_t SupabaseHeap::allocated(size_t size)
+{
+  if (!on || !counting || !top)
+  {
+    return NONE;
+  }
+  uint8_t owner = top->subsystem;
+  all[owner].allocations++;
+  _add(owner, size);
+  return owner;
+}
+
+void SupabaseHeap::freed(size_t size, uint8_t owner)
+{
+  if (owner >= SUBSYSTEMS)
+  {
+    return;
+  }
+  all[owner].frees++;
+  _add(owner, -(int32_t)size);
+}
+
+uint32_t SupabaseHeap::freeHeap()
+{
+  return ESP.getFreeHeap();
+}
+
+uint32_t SupabaseHeap::largestBlock()
+{
+#if defined(ESP8266)
+  return ESP.getMaxFreeBlockSize();
+#else
+  return ESP.getMaxAllocHeap();
+#endif
+}
+
+void SupabaseHeap::_add(uint8_t subsystem, int32_t bytes)
+{
+  SupabaseHeapStats &s = all[subsystem];
+  s.live += bytes;
+  if (s.live > s.peak)
+  {
+    s.peak = s.live;
+  }
+}
+
+SupabaseHeapScope::SupabaseHeapScope(uint8_t subsystem_a)
+    : subsystem(subsystem_a)
+{
+  if (!SupabaseHeap::on || SupabaseHeap::current() == subsystem)
+  {
+    return;
+  }
+
+  active = true;
+  parent = SupabaseHeap::top;
+  SupabaseHeap::top = this;
+  SupabaseHeap::all[subsystem].calls++;
+  if (!SupabaseHeap::counting)
+  {
+    before = SupabaseHeap::freeHeap();
+  }
+}
+
+SupabaseHeapScope::~SupabaseHeapScope()
+{
+  if (!active)
+  {
+    return;
+  }
+  SupabaseHeap::top = parent;
+
+  if (!SupabaseHeap::counting)
+  {
+    int32_t kept = (int32_t)before - (int32_t)SupabaseHeap::freeHeap();
+    SupabaseHeap::_add(subsystem, kept - inner);
+    if (parent)
+    {
+      parent->inner += kept;
+    }
+  }
+
+  SupabaseHeapStats &s = SupabaseHeap::all[subsystem];
+  uint32_t block = SupabaseHeap::largestBlock();
+  if (s.minLargestBlock == 0 || block < s.minLargestBlock)
+  {
+    s.minLargestBlock = block;
+  }
+}
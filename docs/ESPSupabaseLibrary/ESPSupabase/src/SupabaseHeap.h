@@ -0,0 +1,88 @@
+#ifndef ESP_Supabase_Heap_h
+#define ESP_Supabase_Heap_h
+
+#include <Arduino.h>
+
+class SupabaseHeapScope;
+
+struct SupabaseHeapStats
+{
+  int32_t live = 0;             // bytes held, negative when it freed more than it was seen allocating
+  int32_t peak = 0;             // highest live
+  uint32_t allocations = 0;     // counted with an allocator hook only
+  uint32_t frees = 0;           // counted with an allocator hook only
+  uint32_t calls = 0;           // scopes entered
+  uint32_t minLargestBlock = 0; // smallest largest-free-block seen when leaving a scope
+};
+
+// Heap accounting per subsystem, off until begin(). The library marks the
+// code of each subsystem with a SupabaseHeapScope.
+//
+// On the device a scope compares the free heap on entry and exit, so live
+// is what the subsystem kept (e.g. a TLS connection) or gave back, which is
+// enough to tell who leaks. With begin(true) an allocator reports every
+// allocation through allocated() / freed() instead (see
+// SupabaseHeapCounting.h for host builds) and the counts are exact.
+class SupabaseHeap
+{
+public:
+  enum Subsystem
+  {
+    REST,      // Supabase
+    REALTIME,  // SupabaseRealtime
+    WEBSOCKET, // WebSocketsClient, as driven by SupabaseRealtime
+    SUBSYSTEMS,
+    NONE = 0xff
+  };
+
+  static void begin(bool counting = false);
+  static void end();
+  static bool enabled();
+  static void reset();
+
+  static const char *name(uint8_t subsystem);
+  static const SupabaseHeapStats &stats(uint8_t subsystem);
+  // subsystem of the innermost scope, NONE outside of them
+  static uint8_t current();
+
+  // e.g. heap rest live=5312 peak=6120 n=40 | realtime live=412 ... | free=21344 block=11200
+  static size_t printTo(Print &out);
+
+  // Allocator hooks: allocated() returns the owner to keep with the block,
+  // freed() gets it back, so a block freed elsewhere is still taken off its owner
+  static uint8_t allocated(size_t size);
+  static void freed(size_t size, uint8_t owner);
+
+  static uint32_t freeHeap();
+  static uint32_t largestBlock();
+
+private:
+  friend class SupabaseHeapScope;
+  static bool on;
+  static bool counting;
+  static SupabaseHeapStats all[SUBSYSTEMS];
+  static SupabaseHeapScope *top;
+  static void _add(uint8_t subsystem, int32_t bytes);
+};
+
+// Attributes heap changes to a subsystem while it exists. Scopes nest: what
+// an inner scope of another subsystem allocates isn't counted again by the
+// outer one, an inner scope of the same subsystem does nothing.
+class SupabaseHeapScope
+{
+private:
+  friend class SupabaseHeap;
+  uint8_t subsystem;
+  bool active = false;
+  uint32_t before = 0;
+  int32_t inner = 0; // bytes kept by nested scopes
+  SupabaseHeapScope *parent = nullptr;
+
+public:
+  SupabaseHeapScope(uint8_t subsystem_a);
+  ~SupabaseHeapScope();
+  SupabaseHeapScope(const SupabaseHeapScope &) = delete;
+  SupabaseHeapScope &operator=(const SupabaseHeapScope &) = delete;
+};
+
+#endif
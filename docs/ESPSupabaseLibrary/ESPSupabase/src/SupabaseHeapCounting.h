@@ -0,0 +1,261 @@
+#ifndef ESP_Supabase_Heap_Counting_h
+#define ESP_Supabase_Heap_Counting_h
+
+// Counting allocator for SupabaseHeap::begin(true), for host builds. Include
+// it in exactly one .cpp. Live blocks are kept in a table keyed by their
+// address, with their size and owner, so frees are taken off the subsystem
+// that allocated them.
+//
+// It replaces the global operator new / delete. Arduino String and C code
+// allocate with malloc, to count those too define SUPABASE_HEAP_WRAP_MALLOC
+// and link with
+//   -Wl,--wrap=malloc,--wrap=free,--wrap=realloc,--wrap=calloc
+// Only calls from the objects being linked are wrapped, not those inside
+// shared libraries (libc, libstdc++). A block one of them allocated and the
+// program frees isn't in the table and is passed through.
+
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SupabaseHeap.h"
+
+#ifdef SUPABASE_HEAP_WRAP_MALLOC
+extern "C"
+{
+  void *__real_malloc(size_t size);
+  void __real_free(void *block);
+  void *__real_realloc(void *block, size_t size);
+}
+#define SUPABASE_HEAP_MALLOC __real_malloc
+#define SUPABASE_HEAP_FREE __real_free
+#define SUPABASE_HEAP_REALLOC __real_realloc
+#else
+#define SUPABASE_HEAP_MALLOC malloc
+#define SUPABASE_HEAP_FREE free
+#define SUPABASE_HEAP_REALLOC realloc
+#endif
+
+namespace SupabaseHeapCounting
+{
+  // open addressing with linear probing, the table itself never allocates
+  const uint8_t BITS = 18;
+  const size_t SLOTS = (size_t)1 << BITS;
+
+  struct Entry
+  {
+    void *block;
+    size_t size;
+    uint8_t owner;
+  };
+
+  inline Entry *entries()
+  {
+    static Entry table[SLOTS];
+    return table;
+  }
+
+  inline size_t &used()
+  {
+    static size_t count = 0;
+    return count;
+  }
+
+  inline size_t home(void *block)
+  {
+    return (size_t)(((uint64_t)(uintptr_t)block * 0x9E3779B97F4A7C15ull) >> (64 - BITS));
+  }
+
+  inline Entry *find(void *block)
+  {
+    Entry *table = entries();
+    for (size_t i = home(block);; i = (i + 1) & (SLOTS - 1))
+    {
+      if (table[i].block == block)
+      {
+        return &table[i];
+      }
+      if (!table[i].block)
+      {
+        return nullptr;
+      }
+    }
+  }
+
+  inline void insert(void *block, size_t size, uint8_t owner)
+  {
+    Entry *table = entries();
+    if (used() >= SLOTS - SLOTS / 4)
+    {
+      fprintf(stderr, "SupabaseHeapCounting: more than %zu live blocks\n", used());
+      abort();
+    }
+    size_t i = home(block);
+    while (table[i].block && table[i].block != block)
+    {
+      i = (i + 1) & (SLOTS - 1);
+    }
+    if (!table[i].block)
+    {
+      used()++;
+    }
+    table[i] = {block, size, owner};
+  }
+
+  // backward shift deletion, keeps every probe chain unbroken without tombstones
+  inline void erase(Entry *entry)
+  {
+    Entry *table = entries();
+    size_t hole = entry - table;
+    for (size_t i = (hole + 1) & (SLOTS - 1); table[i].block; i = (i + 1) & (SLOTS - 1))
+    {
+      size_t wanted = home(table[i].block);
+      // move it into the hole unless its home lies cyclically in (hole, i]
+      if (((i - wanted) & (SLOTS - 1)) >= ((i - hole) & (SLOTS - 1)))
+      {
+        table[hole] = table[i];
+        hole = i;
+      }
+    }
+    table[hole].block = nullptr;
+    used()--;
+  }
+
+  inline void *allocate(size_t size)
+  {
+    void *block = SUPABASE_HEAP_MALLOC(size ? size : 1);
+    if (!block)
+    {
+      return nullptr;
+    }
+    insert(block, size, SupabaseHeap::allocated(size));
+    return block;
+  }
+
+  inline void release(void *block)
+  {
+    if (!block)
+    {
+      return;
+    }
+    Entry *entry = find(block);
+    if (entry)
+    {
+      SupabaseHeap::freed(entry->size, entry->owner);
+      erase(entry);
+    }
+    SUPABASE_HEAP_FREE(block);
+  }
+
+  // counted as a free of the old block and an allocation of the new one
+  inline void *resize(void *block, size_t size)
+  {
+    if (!block)
+    {
+      return allocate(size);
+    }
+    if (size == 0)
+    {
+      release(block);
+      return nullptr;
+    }
+    Entry *entry = find(block);
+    if (!entry)
+    {
+      return SUPABASE_HEAP_REALLOC(block, size);
+    }
+    size_t before = entry->size;
+    uint8_t owner = entry->owner;
+    void *moved = SUPABASE_HEAP_REALLOC(block, size);
+    if (!moved)
+    {
+      return nullptr;
+    }
+    erase(entry);
+    SupabaseHeap::freed(before, owner);
+    insert(moved, size, SupabaseHeap::allocated(size));
+    return moved;
+  }
+}
+
+#ifdef SUPABASE_HEAP_WRAP_MALLOC
+extern "C"
+{
+  void *__wrap_malloc(size_t size)
+  {
+    return SupabaseHeapCounting::allocate(size);
+  }
+
+  void __wrap_free(void *block)
+  {
+    SupabaseHeapCounting::release(block);
+  }
+
+  void *__wrap_realloc(void *block, size_t size)
+  {
+    return SupabaseHeapCounting::resize(block, size);
+  }
+
+  void *__wrap_calloc(size_t count, size_t size)
+  {
+    if (size > 0 && count > (size_t)-1 / size)
+    {
+      return nullptr;
+    }
+    void *block = SupabaseHeapCounting::allocate(count * size);
+    if (block)
+    {
+      memset(block, 0, count * size);
+    }
+    return block;
+  }
+}
+#endif
+
+void *operator new(size_t size)
+{
+  void *block = SupabaseHeapCounting::allocate(size);
+  if (!block)
+  {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return SupabaseHeapCounting::allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return SupabaseHeapCounting::allocate(size);
+}
+
+void operator delete(void *block) noexcept
+{
+  SupabaseHeapCounting::release(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+  SupabaseHeapCounting::release(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+  SupabaseHeapCounting::release(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+  SupabaseHeapCounting::release(block);
+}
+
+#endif
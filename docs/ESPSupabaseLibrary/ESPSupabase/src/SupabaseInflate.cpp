@@ -0,0 +1,547 @@
+#include "SupabaseInflate.h"
+
+// DEFLATE (RFC 1951) inside a gzip member (RFC 1952). Huffman codes are
+// decoded bit by bit from canonical counts, slow next to table driven
+// decoders but it needs no tables beyond the symbol lists.
+
+static const size_t windowSize = 32768;
+static const uint16_t windowMask = windowSize - 1;
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// order of the code length code lengths in a dynamic block header
+static const uint8_t codeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+SupabaseInflateStream::~SupabaseInflateStream()
+{
+  end();
+}
+
+bool SupabaseInflateStream::begin(Stream &source_a)
+{
+  end();
+  tables = (Tables *)malloc(sizeof(Tables));
+  if (!tables)
+  {
+    state = FAILED;
+    return false;
+  }
+  tables->lengthCode.symbol = tables->lengthSymbols;
+  tables->distanceCode.symbol = tables->distanceSymbols;
+
+  source = &source_a;
+  state = HEADER;
+  position = 0;
+  bitBuffer = 0;
+  bitCount = 0;
+  lastBlock = false;
+  storedLeft = 0;
+  copyLeft = 0;
+  peeked = -1;
+  produced = 0;
+  return true;
+}
+
+void SupabaseInflateStream::end()
+{
+  if (tables)
+  {
+    free(tables);
+    tables = nullptr;
+  }
+}
+
+// next compressed byte, waits up to the source timeout
+int SupabaseInflateStream::_byte()
+{
+  uint8_t c;
+  if (source->readBytes(&c, 1) != 1)
+  {
+    return -1;
+  }
+  return c;
+}
+
+int SupabaseInflateStream::_bits(uint8_t need)
+{
+  while (bitCount < need)
+  {
+    int c = _byte();
+    if (c < 0)
+    {
+      return -1;
+    }
+    bitBuffer |= (uint32_t)c << bitCount;
+    bitCount += 8;
+  }
+  int value = bitBuffer & ((1UL << need) - 1);
+  bitBuffer >>= need;
+  bitCount -= need;
+  return value;
+}
+
+int SupabaseInflateStream::_decode(Huffman &h)
+{
+  int code = 0;  // bits read so far
+  int first = 0; // first code of the current length
+  int index = 0; // index of that code in h.symbol
+  for (uint8_t len = 1; len < 16; len++)
+  {
+    int bit = _bits(1);
+    if (bit < 0)
+    {
+      return -1;
+    }
+    code |= bit;
+    int count = h.count[len];
+    if (code - first < count)
+    {
+      return h.symbol[index + code - first];
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+// canonical Huffman code from code lengths, negative if over-subscribed
+int SupabaseInflateStream::_build(Huffman &h, const uint8_t *lengths, uint16_t n)
+{
+  memset(h.count, 0, sizeof(h.count));
+  for (uint16_t symbol = 0; symbol < n; symbol++)
+  {
+    h.count[lengths[symbol]]++;
+  }
+  if (h.count[0] == n)
+  {
+    return 0;
+  }
+
+  int left = 1;
+  for (uint8_t len = 1; len < 16; len++)
+  {
+    left <<= 1;
+    left -= h.count[len];
+    if (left < 0)
+    {
+      return left;
+    }
+  }
+
+  uint16_t offsets[16];
+  offsets[1] = 0;
+  for (uint8_t len = 1; len < 15; len++)
+  {
+    offsets[len + 1] = offsets[len] + h.count[len];
+  }
+  for (uint16_t symbol = 0; symbol < n; symbol++)
+  {
+    if (lengths[symbol] != 0)
+    {
+      h.symbol[offsets[lengths[symbol]]++] = symbol;
+    }
+  }
+  return left;
+}
+
+bool SupabaseInflateStream::_header()
+{
+  uint8_t head[10];
+  for (uint8_t i = 0; i < 10; i++)
+  {
+    int c = _byte();
+    if (c < 0)
+    {
+      return false;
+    }
+    head[i] = c;
+  }
+  // magic and method 8 (deflate)
+  if (head[0] != 0x1f || head[1] != 0x8b || head[2] != 8)
+  {
+    return false;
+  }
+
+  uint8_t flags = head[3];
+  if (flags & 0x04)
+  {
+    // FEXTRA
+    int lo = _byte();
+    int hi = _byte();
+    if (lo < 0 || hi < 0)
+    {
+      return false;
+    }
+    for (uint16_t n = lo | (hi << 8); n > 0; n--)
+    {
+      if (_byte() < 0)
+      {
+        return false;
+      }
+    }
+  }
+  for (uint8_t flag = 0x08; flag <= 0x10; flag <<= 1)
+  {
+    // FNAME, FCOMMENT: zero terminated
+    if (flags & flag)
+    {
+      int c;
+      do
+      {
+        c = _byte();
+      } while (c > 0);
+      if (c < 0)
+      {
+        return false;
+      }
+    }
+  }
+  if (flags & 0x02)
+  {
+    // FHCRC
+    if (_byte() < 0 || _byte() < 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SupabaseInflateStream::_fixed()
+{
+  uint8_t *lengths = tables->lengths;
+  uint16_t symbol = 0;
+  for (; symbol < 144; symbol++)
+    lengths[symbol] = 8;
+  for (; symbol < 256; symbol++)
+    lengths[symbol] = 9;
+  for (; symbol < 280; symbol++)
+    lengths[symbol] = 7;
+  for (; symbol < 288; symbol++)
+    lengths[symbol] = 8;
+  _build(tables->lengthCode, lengths, 288);
+
+  for (symbol = 0; symbol < 30; symbol++)
+    lengths[symbol] = 5;
+  _build(tables->distanceCode, lengths, 30);
+}
+
+bool SupabaseInflateStream::_dynamic()
+{
+  int nlen = _bits(5);
+  int ndist = _bits(5);
+  int ncode = _bits(4);
+  if (nlen < 0 || ndist < 0 || ncode < 0)
+  {
+    return false;
+  }
+  nlen += 257;
+  ndist += 1;
+  ncode += 4;
+  if (nlen > 286 || ndist > 30)
+  {
+    return false;
+  }
+
+  uint8_t *lengths = tables->lengths;
+  memset(lengths, 0, 19);
+  for (uint8_t i = 0; i < ncode; i++)
+  {
+    int len = _bits(3);
+    if (len < 0)
+    {
+      return false;
+    }
+    lengths[codeLengthOrder[i]] = len;
+  }
+  // the code length code is only needed until the real codes are built
+  if (_build(tables->lengthCode, lengths, 19) != 0)
+  {
+    return false;
+  }
+
+  uint16_t index = 0;
+  while (index < nlen + ndist)
+  {
+    int symbol = _decode(tables->lengthCode);
+    if (symbol < 0)
+    {
+      return false;
+    }
+    if (symbol < 16)
+    {
+      lengths[index++] = symbol;
+      continue;
+    }
+
+    uint8_t len = 0;
+    int repeat;
+    if (symbol == 16)
+    {
+      if (index == 0)
+      {
+        return false;
+      }
+      len = lengths[index - 1];
+      repeat = _bits(2);
+      repeat = repeat < 0 ? -1 : 3 + repeat;
+    }
+    else if (symbol == 17)
+    {
+      repeat = _bits(3);
+      repeat = repeat < 0 ? -1 : 3 + repeat;
+    }
+    else
+    {
+      repeat = _bits(7);
+      repeat = repeat < 0 ? -1 : 11 + repeat;
+    }
+    if (repeat < 0 || index + repeat > nlen + ndist)
+    {
+      return false;
+    }
+    while (repeat--)
+    {
+      lengths[index++] = len;
+    }
+  }
+
+  // end of block code is required
+  if (lengths[256] == 0)
+  {
+    return false;
+  }
+  // incomplete codes are allowed, over-subscribed ones are not
+  if (_build(tables->lengthCode, lengths, nlen) < 0 || _build(tables->distanceCode, lengths + nlen, ndist) < 0)
+  {
+    return false;
+  }
+  return true;
+}
+
+bool SupabaseInflateStream::_block()
+{
+  int last = _bits(1);
+  int type = _bits(2);
+  if (last < 0 || type < 0)
+  {
+    return false;
+  }
+  lastBlock = last;
+
+  if (type == 0)
+  {
+    // stored: byte aligned LEN and its complement
+    bitBuffer = 0;
+    bitCount = 0;
+    int b[4];
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      b[i] = _byte();
+      if (b[i] < 0)
+      {
+        return false;
+      }
+    }
+    uint16_t len = b[0] | (b[1] << 8);
+    uint16_t nlen = b[2] | (b[3] << 8);
+    if (len != (uint16_t)~nlen)
+    {
+      return false;
+    }
+    storedLeft = len;
+    state = STORED;
+    return true;
+  }
+  if (type == 1)
+  {
+    _fixed();
+  }
+  else if (type != 2 || !_dynamic())
+  {
+    return false;
+  }
+  state = CODES;
+  return true;
+}
+
+uint8_t SupabaseInflateStream::_put(uint8_t c)
+{
+  tables->window[position] = c;
+  position = (position + 1) & windowMask;
+  produced++;
+  return c;
+}
+
+int SupabaseInflateStream::_read()
+{
+  while (true)
+  {
+    switch (state)
+    {
+    case HEADER:
+      if (!_header())
+      {
+        state = FAILED;
+        break;
+      }
+      state = BLOCK;
+      break;
+
+    case BLOCK:
+      if (!_block())
+      {
+        state = FAILED;
+      }
+      break;
+
+    case STORED:
+    {
+      if (storedLeft == 0)
+      {
+        state = lastBlock ? TRAILER : BLOCK;
+        break;
+      }
+      int c = _byte();
+      if (c < 0)
+      {
+        state = FAILED;
+        break;
+      }
+      storedLeft--;
+      return _put(c);
+    }
+
+    case CODES:
+    {
+      int symbol = _decode(tables->lengthCode);
+      if (symbol < 0)
+      {
+        state = FAILED;
+        break;
+      }
+      if (symbol < 256)
+      {
+        return _put(symbol);
+      }
+      if (symbol == 256)
+      {
+        state = lastBlock ? TRAILER : BLOCK;
+        break;
+      }
+
+      symbol -= 257;
+      if (symbol >= 29)
+      {
+        state = FAILED;
+        break;
+      }
+      int extra = _bits(lengthExtra[symbol]);
+      int distance = _decode(tables->distanceCode);
+      if (extra < 0 || distance < 0 || distance >= 30)
+      {
+        state = FAILED;
+        break;
+      }
+      int distanceBits = _bits(distanceExtra[distance]);
+      if (distanceBits < 0)
+      {
+        state = FAILED;
+        break;
+      }
+      copyLeft = lengthBase[symbol] + extra;
+      copyDistance = distanceBase[distance] + distanceBits;
+      if (copyDistance > produced)
+      {
+        // refers to before the start of the data
+        state = FAILED;
+        break;
+      }
+      state = COPY;
+      break;
+    }
+
+    case COPY:
+      if (copyLeft == 0)
+      {
+        state = CODES;
+        break;
+      }
+      copyLeft--;
+      return _put(tables->window[(position - copyDistance) & windowMask]);
+
+    case TRAILER:
+      // CRC32 and ISIZE, byte aligned. Read so the body ends where the server ended it.
+      bitBuffer = 0;
+      bitCount = 0;
+      for (uint8_t i = 0; i < 8; i++)
+      {
+        if (_byte() < 0)
+        {
+          break;
+        }
+      }
+      state = DONE;
+      end();
+      break;
+
+    case DONE:
+    case FAILED:
+      end();
+      return -1;
+    }
+  }
+}
+
+int SupabaseInflateStream::available()
+{
+  if (peeked >= 0)
+  {
+    return 1;
+  }
+  return state != DONE && state != FAILED ? 1 : 0;
+}
+
+int SupabaseInflateStream::read()
+{
+  if (peeked >= 0)
+  {
+    int c = peeked;
+    peeked = -1;
+    return c;
+  }
+  return _read();
+}
+
+int SupabaseInflateStream::peek()
+{
+  if (peeked < 0)
+  {
+    peeked = _read();
+  }
+  return peeked;
+}
+
+size_t SupabaseInflateStream::write(uint8_t)
+{
+  return 0;
+}
+
+bool SupabaseInflateStream::finished()
+{
+  return state == DONE && peeked < 0;
+}
+
+bool SupabaseInflateStream::failed()
+{
+  return state == FAILED;
+}
+
+uint32_t SupabaseInflateStream::bytesRead()
+{
+  return produced;
+}
@@ -0,0 +1,83 @@
+#ifndef ESP_Supabase_Inflate_h
+#define ESP_Supabase_Inflate_h
+
+#include <Arduino.h>
+
+// gzip decoding as a Stream, one byte at a time, so a compressed response is
+// never held in memory. The 32 KB DEFLATE window (the largest distance gzip
+// may refer back to) and the Huffman tables share one block allocated in
+// begin() and freed in end(), the object itself is a few words.
+class SupabaseInflateStream : public Stream
+{
+private:
+  enum State
+  {
+    HEADER,
+    BLOCK,
+    STORED,
+    CODES,
+    COPY,
+    TRAILER,
+    DONE,
+    FAILED
+  };
+
+  struct Huffman
+  {
+    uint16_t count[16];  // number of codes of each length
+    uint16_t *symbol;    // symbols ordered by code
+  };
+
+  struct Tables
+  {
+    uint8_t window[32768];
+    uint16_t lengthSymbols[288];
+    uint16_t distanceSymbols[30];
+    uint8_t lengths[286 + 30]; // code lengths while a block header is read
+    Huffman lengthCode;
+    Huffman distanceCode;
+  };
+
+  Stream *source = nullptr;
+  State state = DONE;
+  Tables *tables = nullptr;
+  uint16_t position = 0;
+  uint32_t bitBuffer = 0;
+  uint8_t bitCount = 0;
+  bool lastBlock = false;
+  uint16_t storedLeft = 0;
+  uint16_t copyLeft = 0;
+  uint16_t copyDistance = 0;
+  int peeked = -1;
+  uint32_t produced = 0;
+
+  int _byte();
+  int _bits(uint8_t need);
+  int _decode(Huffman &h);
+  static int _build(Huffman &h, const uint8_t *lengths, uint16_t n);
+  bool _header();
+  bool _block();
+  bool _dynamic();
+  void _fixed();
+  uint8_t _put(uint8_t c);
+  int _read();
+
+public:
+  ~SupabaseInflateStream();
+
+  // source is the compressed body, false if the tables can't be allocated
+  bool begin(Stream &source_a);
+  void end();
+
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t);
+
+  bool finished();
+  bool failed();
+  // decompressed bytes read so far
+  uint32_t bytesRead();
+};
+
+#endif
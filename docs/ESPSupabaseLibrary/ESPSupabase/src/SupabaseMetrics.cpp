@@ -0,0 +1,254 @@
+#include "SupabaseMetrics.h"
+
+const uint16_t SupabaseHistogram::bounds[SUPABASE_METRICS_BUCKETS - 1] = {25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+void SupabaseHistogram::add(uint32_t ms)
+{
+  uint8_t i = 0;
+  while (i < SUPABASE_METRICS_BUCKETS - 1 && ms > bounds[i])
+  {
+    i++;
+  }
+  counts[i]++;
+  if (ms > max)
+  {
+    max = ms;
+  }
+}
+
+uint32_t SupabaseHistogram::count() const
+{
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < SUPABASE_METRICS_BUCKETS; i++)
+  {
+    n += counts[i];
+  }
+  return n;
+}
+
+uint32_t SupabaseHistogram::bucket(uint8_t i) const
+{
+  return i < SUPABASE_METRICS_BUCKETS ? counts[i] : 0;
+}
+
+uint32_t SupabaseHistogram::percentile(uint8_t p) const
+{
+  uint32_t n = count();
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  // rank of the p-th percentile, rounded up
+  uint32_t rank = ((uint64_t)n * p + 99) / 100;
+  if (rank == 0)
+  {
+    rank = 1;
+  }
+
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < SUPABASE_METRICS_BUCKETS - 1; i++)
+  {
+    seen += counts[i];
+    if (seen >= rank)
+    {
+      return bounds[i] < max ? bounds[i] : max;
+    }
+  }
+  return max;
+}
+
+uint32_t SupabaseHistogram::maximum() const
+{
+  return max;
+}
+
+const char *SupabaseMetrics::name(uint8_t endpoint)
+{
+  static const char *names[] = {"rest", "rpc", "auth", "storage"};
+  return endpoint < ENDPOINTS ? names[endpoint] : "";
+}
+
+uint8_t SupabaseMetrics::endpointOf(const char *path)
+{
+  if (strstr(path, "/rest/v1/rpc/"))
+  {
+    return RPC;
+  }
+  if (strstr(path, "/auth/v1/"))
+  {
+    return AUTH;
+  }
+  if (strstr(path, "/storage/v1/"))
+  {
+    return STORAGE;
+  }
+  return REST;
+}
+
+const SupabaseEndpointStats &SupabaseMetrics::endpoint(uint8_t endpoint) const
+{
+  return stats[endpoint < ENDPOINTS ? endpoint : REST];
+}
+
+const SupabaseRequestTiming &SupabaseMetrics::last() const
+{
+  return recorded;
+}
+
+void SupabaseMetrics::reset()
+{
+  for (uint8_t i = 0; i < ENDPOINTS; i++)
+  {
+    stats[i] = SupabaseEndpointStats();
+  }
+  recorded = SupabaseRequestTiming();
+}
+
+size_t SupabaseMetrics::printTo(Print &out) const
+{
+  size_t n = 0;
+  for (uint8_t i = 0; i < ENDPOINTS; i++)
+  {
+    const SupabaseEndpointStats &s = stats[i];
+    if (s.requests == 0)
+    {
+      continue;
+    }
+
+    uint32_t opened = s.requests - s.reused;
+    char line[200];
+    int length = snprintf(line, sizeof(line), "%s%s n=%u err=%u reuse=%u p50=%u p90=%u max=%u ttfb50=%u dns=%u conn=%u in=%u out=%u heap=%u",
+                          n > 0 ? " | " : "", name(i),
+                          (unsigned)s.requests, (unsigned)s.errors, (unsigned)s.reused,
+                          (unsigned)s.total.percentile(50), (unsigned)s.total.percentile(90), (unsigned)s.total.maximum(),
+                          (unsigned)s.firstByte.percentile(50),
+                          (unsigned)(opened ? s.dns / opened : 0), (unsigned)(opened ? s.connect / opened : 0),
+                          (unsigned)s.bytesIn, (unsigned)s.bytesOut, (unsigned)s.minHeap);
+    if (length > 0)
+    {
+      n += out.write((const uint8_t *)line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+    }
+  }
+  n += out.println();
+  return n;
+}
+
+void SupabaseMetrics::record(const SupabaseRequestTiming &timing)
+{
+  SupabaseEndpointStats &s = stats[timing.endpoint < ENDPOINTS ? timing.endpoint : REST];
+  s.requests++;
+  if (timing.httpCode <= 0 || timing.httpCode >= 400)
+  {
+    s.errors++;
+  }
+  if (timing.reused)
+  {
+    s.reused++;
+  }
+  s.dns += timing.dns;
+  s.connect += timing.connect;
+  s.send += timing.send;
+  s.body += timing.body;
+  s.bytesOut += timing.bytesOut;
+  s.bytesIn += timing.bytesIn;
+  if (s.minHeap == 0 || timing.heapAfter < s.minHeap)
+  {
+    s.minHeap = timing.heapAfter;
+  }
+  s.total.add(timing.total);
+  if (timing.httpCode > 0)
+  {
+    s.firstByte.add(timing.firstByte);
+  }
+
+  recorded = timing;
+}
+
+void SupabaseRequestTimer::begin(SupabaseMetrics &metrics_a, const char *path)
+{
+  if (running)
+  {
+    // the previous one never got to end(), e.g. it failed before its body
+    end();
+  }
+
+  metrics = &metrics_a;
+  current = SupabaseRequestTiming();
+  current.endpoint = SupabaseMetrics::endpointOf(path);
+  current.heapBefore = ESP.getFreeHeap();
+  started = millis();
+  lastMark = started;
+  running = true;
+}
+
+void SupabaseRequestTimer::mark(SupabaseMetrics::Phase phase)
+{
+  if (!running)
+  {
+    return;
+  }
+
+  unsigned long now = millis();
+  uint32_t elapsed = now - lastMark;
+  lastMark = now;
+
+  switch (phase)
+  {
+  case SupabaseMetrics::DNS:
+    current.dns += elapsed;
+    break;
+  case SupabaseMetrics::CONNECT:
+    current.connect += elapsed;
+    break;
+  case SupabaseMetrics::SEND:
+    current.send += elapsed;
+    break;
+  case SupabaseMetrics::FIRST_BYTE:
+    current.firstByte += elapsed;
+    break;
+  case SupabaseMetrics::BODY:
+    current.body += elapsed;
+    break;
+  }
+}
+
+void SupabaseRequestTimer::reused(bool reused)
+{
+  current.reused = reused;
+}
+
+void SupabaseRequestTimer::response(int httpCode)
+{
+  mark(SupabaseMetrics::FIRST_BYTE);
+  current.httpCode = httpCode;
+}
+
+void SupabaseRequestTimer::bytes(uint32_t out, uint32_t in)
+{
+  current.bytesOut += out;
+  current.bytesIn += in;
+}
+
+void SupabaseRequestTimer::end()
+{
+  if (!running)
+  {
+    return;
+  }
+  running = false;
+
+  if (current.httpCode > 0)
+  {
+    mark(SupabaseMetrics::BODY);
+  }
+  current.total = millis() - started;
+  current.heapAfter = ESP.getFreeHeap();
+
+  metrics->record(current);
+}
+
+bool SupabaseRequestTimer::active() const
+{
+  return running;
+}
@@ -0,0 +1,134 @@
+#ifndef ESP_Supabase_Metrics_h
+#define ESP_Supabase_Metrics_h
+
+#include <Arduino.h>
+
+// upper bounds in ms, the last bucket holds everything slower
+#define SUPABASE_METRICS_BUCKETS 10
+
+// Timings of one request. Phases follow each other, a phase that didn't
+// happen (e.g. dns and connect on a reused connection) is 0.
+struct SupabaseRequestTiming
+{
+  uint8_t endpoint = 0;
+  int httpCode = 0;
+  bool reused = false;
+  uint32_t dns = 0;       // host lookup
+  uint32_t connect = 0;   // TCP connect and TLS handshake, WiFiClientSecure does both in one call
+  uint32_t send = 0;      // writing the request
+  uint32_t firstByte = 0; // waiting for the response head
+  uint32_t body = 0;      // reading the body
+  uint32_t total = 0;
+  uint32_t bytesOut = 0;
+  uint32_t bytesIn = 0;
+  uint32_t heapBefore = 0;
+  uint32_t heapAfter = 0;
+};
+
+// Fixed-bucket latency histogram
+class SupabaseHistogram
+{
+private:
+  uint32_t counts[SUPABASE_METRICS_BUCKETS] = {};
+  uint32_t max = 0;
+
+public:
+  static const uint16_t bounds[SUPABASE_METRICS_BUCKETS - 1];
+
+  void add(uint32_t ms);
+  uint32_t count() const;
+  uint32_t bucket(uint8_t i) const;
+  // upper bound of the bucket holding the p-th percentile, the maximum for the last bucket
+  uint32_t percentile(uint8_t p) const;
+  uint32_t maximum() const;
+};
+
+struct SupabaseEndpointStats
+{
+  uint32_t requests = 0;
+  uint32_t errors = 0; // no response or a status >= 400
+  uint32_t reused = 0;
+  uint32_t dns = 0;    // phase sums in ms, divide by requests for the mean
+  uint32_t connect = 0;
+  uint32_t send = 0;
+  uint32_t body = 0;
+  uint32_t bytesOut = 0;
+  uint32_t bytesIn = 0;
+  uint32_t minHeap = 0; // lowest free heap seen after a request
+  SupabaseHistogram total;
+  SupabaseHistogram firstByte;
+};
+
+// Per-request timings, aggregated per endpoint. Give one to
+// Supabase::setMetrics() (it can be shared by several clients), every
+// request is then recorded. Requests that need a retry are recorded once
+// per attempt.
+class SupabaseMetrics
+{
+public:
+  enum Endpoint
+  {
+    REST,
+    RPC,
+    AUTH,
+    STORAGE,
+    ENDPOINTS
+  };
+
+  enum Phase
+  {
+    DNS,
+    CONNECT,
+    SEND,
+    FIRST_BYTE,
+    BODY
+  };
+
+  static const char *name(uint8_t endpoint);
+  // endpoint of a url or path, REST for anything unknown
+  static uint8_t endpointOf(const char *path);
+
+  const SupabaseEndpointStats &endpoint(uint8_t endpoint) const;
+  // the last request recorded
+  const SupabaseRequestTiming &last() const;
+  void reset();
+
+  // One line per call, only endpoints that saw requests, e.g.
+  // rest n=12 err=0 reuse=11 p50=250 p90=500 max=812 ttfb50=100 dns=3 conn=410 in=5120 out=960 heap=21344
+  // (dns and conn are means per new connection, in and out are bytes)
+  size_t printTo(Print &out) const;
+
+  // adds a finished request, SupabaseRequestTimer::end() calls it
+  void record(const SupabaseRequestTiming &timing);
+
+private:
+  SupabaseEndpointStats stats[ENDPOINTS];
+  SupabaseRequestTiming recorded;
+};
+
+// Times the request in flight and records it in a SupabaseMetrics when it
+// ends. Every client keeps its own (its async engine another one), so
+// clients sharing the metrics and overlapping requests don't mix timings.
+// It can also wrap requests made without Supabase: begin(), mark() at the
+// end of each phase, response() once the status is known (it ends
+// FIRST_BYTE), end() after the body.
+class SupabaseRequestTimer
+{
+public:
+  void begin(SupabaseMetrics &metrics, const char *path);
+  void mark(SupabaseMetrics::Phase phase);
+  void reused(bool reused);
+  void response(int httpCode);
+  void bytes(uint32_t out, uint32_t in);
+  void end();
+  bool active() const;
+
+private:
+  SupabaseMetrics *metrics = nullptr;
+  SupabaseRequestTiming current;
+  unsigned long started = 0;
+  unsigned long lastMark = 0;
+  bool running = false;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include "ESPSupabase.h"
+
+SupabasePrepared Supabase::prepare(const char *method, const String &path, const String &prefer, const String &accept)
+{
+  SupabasePrepared request;
+  request.method = method;
+
+  request.target.reserve(strlen(method) + 1 + path.length());
+  request.target = method;
+  request.target += ' ';
+  request.target += path;
+
+  request.headers.reserve(110 + host.length() + key.length() + prefer.length() + accept.length());
+  request.headers = " HTTP/1.1\r\nHost: ";
+  request.headers += host;
+  request.headers += "\r\napikey: ";
+  request.headers += key;
+  request.headers += "\r\nContent-Type: application/json\r\nUser-Agent: ESP32/Supabase\r\n";
+  if (prefer.length() > 0)
+  {
+    request.headers += "Prefer: ";
+    request.headers += prefer;
+    request.headers += "\r\n";
+  }
+  if (accept.length() > 0)
+  {
+    request.headers += "Accept: ";
+    request.headers += accept;
+    request.headers += "\r\n";
+  }
+  return request;
+}
+
+SupabasePrepared Supabase::prepare(const char *method, const SupabaseQuery &query, const String &prefer, const String &accept)
+{
+  return prepare(method, String("/rest/v1/") + query.c_str(), prefer, accept);
+}
+
+// Writes a prepared request and reads the response head, body is left for the caller.
+// Retried like _open(); a kept-alive connection the server already closed is
+// reopened once for free when the request never reached it, or when it is
+// idempotent. A connection lost after the body was flushed may have been
+// processed, a POST or PATCH is not sent twice.
+int Supabase::_executeOpen(SupabasePrepared &request, const String &payload, const char *params, SupabaseBodyStream &body, bool &close, const char *const *keys, String *values, uint8_t count)
+{
+  bool idempotent = SupabaseRetryPolicy::idempotent(request.method);
+  bool head = strcmp(request.method, "HEAD") == 0;
+  bool staleRetried = false;
+
+  char contentLength[40];
+  snprintf(contentLength, sizeof(contentLength), "Content-Length: %u\r\n\r\n", payload.length());
+
+  int httpCode;
+  for (uint8_t attempt = 1;;)
+  {
+    _check_auth();
+    if (metrics)
+    {
+      requestTimer.begin(*metrics, request.target.c_str());
+    }
+
+    bool reused = false;
+    if (!_rawConnect(&reused))
+    {
+      httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    else
+    {
+      uint8_t stackBuffer[SUPABASE_UPLOAD_BUFFER];
+      SupabaseUploadWriter writer(client, uploadBuffer ? uploadBuffer : stackBuffer, uploadBuffer ? uploadBufferSize : sizeof(stackBuffer));
+
+      writer.put(request.target);
+      if (params)
+      {
+        writer.put((const uint8_t *)params, strlen(params));
+      }
+      writer.put(request.headers);
+      if (!keepAlive)
+      {
+        writer.put((const uint8_t *)"Connection: close\r\n", 19);
+      }
+      if (acceptGzip)
+      {
+        writer.put((const uint8_t *)"Accept-Encoding: gzip\r\n", 23);
+      }
+      if (useAuth)
+      {
+        writer.put((const uint8_t *)"Authorization: Bearer ", 22);
+        writer.put(USER_TOKEN);
+        writer.put((const uint8_t *)"\r\n", 2);
+      }
+      writer.put((const uint8_t *)contentLength, strlen(contentLength));
+      writer.put(payload);
+
+      if (!writer.flush())
+      {
+        httpCode = HTTPC_ERROR_SEND_HEADER_FAILED;
+      }
+      else
+      {
+        if (metrics)
+        {
+          requestTimer.bytes(writer.bytesSent(), 0);
+        }
+        httpCode = _rawResponse(body, close, head, keys, values, count);
+      }
+      if (httpCode <= 0)
+      {
+        _rawEnd(true);
+      }
+    }
+
+    if (reused && !staleRetried && (httpCode == HTTPC_ERROR_SEND_HEADER_FAILED || (idempotent && httpCode == HTTPC_ERROR_CONNECTION_LOST)))
+    {
+      staleRetried = true;
+      connectionStats.reconnects++;
+      continue;
+    }
+
+    bool retry = idempotent ? SupabaseRetryPolicy::retryable(httpCode) : httpCode == HTTPC_ERROR_CONNECTION_REFUSED;
+    if (!retry || !_retry().shouldRetry(attempt))
+    {
+      return httpCode;
+    }
+
+    if (httpCode > 0)
+    {
+      // retryable status, skip its body so the connection can be reused
+      if (!body.drain())
+      {
+        close = true;
+      }
+      _rawEnd(close);
+    }
+    unsigned long wait = _retry().backoff(attempt);
+    Serial.printf("Request failed (%d), retrying in %lu ms\n", httpCode, wait);
+    delay(wait);
+    attempt++;
+  }
+}
+
+static const char *encodingKey[] = {"content-encoding"};
+
+int Supabase::execute(SupabasePrepared &request, const String &payload, String *response, const char *params)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool close = false;
+  String encoding;
+  int httpCode = _executeOpen(request, payload, params, body, close, encodingKey, &encoding, 1);
+  if (httpCode <= 0)
+  {
+    return httpCode;
+  }
+
+  bool gzip = encoding.equalsIgnoreCase("gzip");
+  if (response && gzip && !_inflate(body))
+  {
+    body.drain();
+    _rawEnd(true);
+    *response = "";
+    return -102;
+  }
+  if (response)
+  {
+    *response = _decoded(body, gzip).readString();
+    inflate.end();
+  }
+  if (!body.drain())
+  {
+    close = true;
+  }
+  if (metrics)
+  {
+    requestTimer.bytes(0, body.bytesRead());
+  }
+  _rawEnd(close);
+  return httpCode;
+}
+
+int Supabase::execute(SupabasePrepared &request, JsonDocument &doc, JsonDocument *filter, const char *params)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  SupabaseBodyStream body;
+  bool close = false;
+  String encoding;
+  int httpCode = _executeOpen(request, "", params, body, close, encodingKey, &encoding, 1);
+  if (httpCode <= 0)
+  {
+    return httpCode;
+  }
+
+  bool gzip = encoding.equalsIgnoreCase("gzip");
+  if (gzip && !_inflate(body))
+  {
+    body.drain();
+    _rawEnd(true);
+    return -102;
+  }
+  Stream &in = _decoded(body, gzip);
+
+  DeserializationError error;
+  if (filter)
+  {
+    error = deserializeJson(doc, in, DeserializationOption::Filter(*filter));
+  }
+  else
+  {
+    error = deserializeJson(doc, in);
+  }
+  inflate.end();
+  if (error)
+  {
+    Serial.print("Response parse failed: ");
+    Serial.println(error.c_str());
+  }
+
+  if (!body.drain())
+  {
+    close = true;
+  }
+  if (metrics)
+  {
+    requestTimer.bytes(0, body.bytesRead());
+  }
+  _rawEnd(close);
+  return httpCode;
+}
@@ -0,0 +1,22 @@
+#ifndef ESP_Supabase_Prepared_h
+#define ESP_Supabase_Prepared_h
+
+#include <Arduino.h>
+
+// A request compiled once by Supabase::prepare(): the request line and every
+// header that never changes live in one buffer. Supabase::execute() only adds
+// what varies per call (query params, token, Content-Length and body) and
+// writes it all without building any String.
+class SupabasePrepared
+{
+private:
+  friend class Supabase;
+  const char *method = "GET";
+  String target;  // "GET /rest/v1/table?filters"
+  String headers; // " HTTP/1.1\r\nHost: ...\r\napikey: ...\r\n"
+
+public:
+  bool valid() const { return target.length() > 0; }
+};
+
+#endif
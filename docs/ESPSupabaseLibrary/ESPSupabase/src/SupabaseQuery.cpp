@@ -0,0 +1,244 @@
+#include "SupabaseQuery.h"
+
+SupabaseQuery::SupabaseQuery(char *buffer_a, size_t capacity_a)
+{
+  buffer = buffer_a;
+  capacity = capacity_a;
+  reset();
+}
+
+void SupabaseQuery::reset()
+{
+  len = 0;
+  overflowed = capacity == 0;
+  if (capacity > 0)
+  {
+    buffer[0] = '\0';
+  }
+}
+
+const char *SupabaseQuery::c_str() const
+{
+  return capacity > 0 ? buffer : "";
+}
+
+size_t SupabaseQuery::length() const
+{
+  return len;
+}
+
+bool SupabaseQuery::overflow() const
+{
+  return overflowed;
+}
+
+void SupabaseQuery::_append(char c)
+{
+  // one byte is always kept for the terminator
+  if (overflowed || len + 1 >= capacity)
+  {
+    overflowed = true;
+    return;
+  }
+  buffer[len++] = c;
+  buffer[len] = '\0';
+}
+
+void SupabaseQuery::_append(const char *str)
+{
+  while (*str)
+  {
+    _append(*str++);
+  }
+}
+
+void SupabaseQuery::_appendEncoded(const char *value)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  for (; *value; value++)
+  {
+    char c = *value;
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~')
+    {
+      _append(c);
+    }
+    else
+    {
+      _append('%');
+      _append(hex[((uint8_t)c) >> 4]);
+      _append(hex[((uint8_t)c) & 0x0F]);
+    }
+  }
+}
+
+void SupabaseQuery::_appendNumber(unsigned long value)
+{
+  char digits[21];
+  uint8_t n = 0;
+  do
+  {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+
+  while (n > 0)
+  {
+    _append(digits[--n]);
+  }
+}
+
+void SupabaseQuery::_check_last_string()
+{
+  if (len > 0 && buffer[len - 1] != '?')
+  {
+    _append('&');
+  }
+}
+
+// Drops a partly written parameter, so the query stays well formed
+SupabaseQuery &SupabaseQuery::_commit(size_t start)
+{
+  if (overflowed && capacity > 0)
+  {
+    len = start;
+    buffer[len] = '\0';
+  }
+  return *this;
+}
+
+SupabaseQuery &SupabaseQuery::_filter(const char *coll, const char *op, const char *value, char open, char close)
+{
+  size_t start = len;
+  _check_last_string();
+  _appendEncoded(coll);
+  _append('=');
+  _append(op);
+  _append('.');
+  if (open)
+  {
+    _append(open);
+  }
+  _appendEncoded(value);
+  if (close)
+  {
+    _append(close);
+  }
+  return _commit(start);
+}
+
+SupabaseQuery &SupabaseQuery::from(const char *table)
+{
+  size_t start = len;
+  _appendEncoded(table);
+  _append('?');
+  return _commit(start);
+}
+
+SupabaseQuery &SupabaseQuery::select(const char *colls)
+{
+  size_t start = len;
+  _check_last_string();
+  _append("select=");
+  _appendEncoded(colls);
+  return _commit(start);
+}
+
+SupabaseQuery &SupabaseQuery::update(const char *table)
+{
+  return from(table);
+}
+
+// Comparison Operator
+SupabaseQuery &SupabaseQuery::eq(const char *coll, const char *conditions)
+{
+  return _filter(coll, "eq", conditions);
+}
+SupabaseQuery &SupabaseQuery::gt(const char *coll, const char *conditions)
+{
+  return _filter(coll, "gt", conditions);
+}
+SupabaseQuery &SupabaseQuery::gte(const char *coll, const char *conditions)
+{
+  return _filter(coll, "gte", conditions);
+}
+SupabaseQuery &SupabaseQuery::lt(const char *coll, const char *conditions)
+{
+  return _filter(coll, "lt", conditions);
+}
+SupabaseQuery &SupabaseQuery::lte(const char *coll, const char *conditions)
+{
+  return _filter(coll, "lte", conditions);
+}
+SupabaseQuery &SupabaseQuery::neq(const char *coll, const char *conditions)
+{
+  return _filter(coll, "neq", conditions);
+}
+SupabaseQuery &SupabaseQuery::in(const char *coll, const char *conditions)
+{
+  return _filter(coll, "in", conditions, '(', ')');
+}
+SupabaseQuery &SupabaseQuery::is(const char *coll, const char *conditions)
+{
+  return _filter(coll, "is", conditions);
+}
+SupabaseQuery &SupabaseQuery::cs(const char *coll, const char *conditions)
+{
+  return _filter(coll, "cs", conditions, '{', '}');
+}
+SupabaseQuery &SupabaseQuery::cd(const char *coll, const char *conditions)
+{
+  return _filter(coll, "cd", conditions, '{', '}');
+}
+SupabaseQuery &SupabaseQuery::ov(const char *coll, const char *conditions)
+{
+  return _filter(coll, "ov", conditions, '{', '}');
+}
+SupabaseQuery &SupabaseQuery::sl(const char *coll, const char *conditions)
+{
+  return _filter(coll, "sl", conditions, '(', ')');
+}
+SupabaseQuery &SupabaseQuery::sr(const char *coll, const char *conditions)
+{
+  return _filter(coll, "sr", conditions, '(', ')');
+}
+SupabaseQuery &SupabaseQuery::nxr(const char *coll, const char *conditions)
+{
+  return _filter(coll, "nxr", conditions, '(', ')');
+}
+SupabaseQuery &SupabaseQuery::nxl(const char *coll, const char *conditions)
+{
+  return _filter(coll, "nxl", conditions, '(', ')');
+}
+SupabaseQuery &SupabaseQuery::adj(const char *coll, const char *conditions)
+{
+  return _filter(coll, "adj", conditions, '(', ')');
+}
+
+// Ordering
+SupabaseQuery &SupabaseQuery::order(const char *coll, const char *by, bool nulls)
+{
+  size_t start = len;
+  _check_last_string();
+  _append("order=");
+  _appendEncoded(coll);
+  _append('.');
+  _appendEncoded(by);
+  _append(nulls ? ".nullslast" : ".nullsfirst");
+  return _commit(start);
+}
+SupabaseQuery &SupabaseQuery::limit(unsigned int by)
+{
+  size_t start = len;
+  _check_last_string();
+  _append("limit=");
+  _appendNumber(by);
+  return _commit(start);
+}
+SupabaseQuery &SupabaseQuery::offset(unsigned int by)
+{
+  size_t start = len;
+  _check_last_string();
+  _append("offset=");
+  _appendNumber(by);
+  return _commit(start);
+}
@@ -0,0 +1,73 @@
+#ifndef ESP_Supabase_Query_h
+#define ESP_Supabase_Query_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Query builder that writes the PostgREST query string into a fixed buffer.
+// It never allocates: when the buffer is full the failing call is rolled back
+// and overflow() returns true, the query must then not be executed.
+class SupabaseQuery
+{
+private:
+  char *buffer;
+  size_t capacity;
+  size_t len;
+  bool overflowed;
+
+  void _append(const char *str);
+  void _append(char c);
+  void _appendEncoded(const char *value);
+  void _appendNumber(unsigned long value);
+  void _check_last_string();
+  SupabaseQuery &_filter(const char *coll, const char *op, const char *value, char open = 0, char close = 0);
+  SupabaseQuery &_commit(size_t start);
+
+public:
+  SupabaseQuery(char *buffer_a, size_t capacity_a);
+
+  void reset();
+  const char *c_str() const;
+  size_t length() const;
+  bool overflow() const;
+
+  SupabaseQuery &from(const char *table);
+  SupabaseQuery &select(const char *colls);
+  SupabaseQuery &update(const char *table);
+
+  // Comparison Operator, values are URL-encoded
+  SupabaseQuery &eq(const char *coll, const char *conditions);
+  SupabaseQuery &gt(const char *coll, const char *conditions);
+  SupabaseQuery &gte(const char *coll, const char *conditions);
+  SupabaseQuery &lt(const char *coll, const char *conditions);
+  SupabaseQuery &lte(const char *coll, const char *conditions);
+  SupabaseQuery &neq(const char *coll, const char *conditions);
+  SupabaseQuery &in(const char *coll, const char *conditions);
+  SupabaseQuery &is(const char *coll, const char *conditions);
+  SupabaseQuery &cs(const char *coll, const char *conditions);
+  SupabaseQuery &cd(const char *coll, const char *conditions);
+  SupabaseQuery &ov(const char *coll, const char *conditions);
+  SupabaseQuery &sl(const char *coll, const char *conditions);
+  SupabaseQuery &sr(const char *coll, const char *conditions);
+  SupabaseQuery &nxr(const char *coll, const char *conditions);
+  SupabaseQuery &nxl(const char *coll, const char *conditions);
+  SupabaseQuery &adj(const char *coll, const char *conditions);
+
+  // Ordering
+  SupabaseQuery &order(const char *coll, const char *by, bool nulls = true);
+  SupabaseQuery &limit(unsigned int by);
+  SupabaseQuery &offset(unsigned int by);
+};
+
+// SupabaseQuery with its own inline buffer of N bytes
+template <size_t N>
+class SupabaseStaticQuery : public SupabaseQuery
+{
+private:
+  char storage[N];
+
+public:
+  SupabaseStaticQuery() : SupabaseQuery(storage, N) {}
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "SupabaseRetry.h"
+
+SupabaseRetryPolicy::SupabaseRetryPolicy(uint8_t maxAttempts_a, unsigned long baseDelay_a, unsigned long maxDelay_a, uint16_t budget_a, unsigned long window_a)
+{
+  maxAttempts = maxAttempts_a;
+  baseDelay = baseDelay_a;
+  maxDelay = maxDelay_a;
+  budget = budget_a;
+  window = window_a;
+}
+
+bool SupabaseRetryPolicy::shouldRetry(uint8_t attempt)
+{
+  if (attempt >= maxAttempts)
+  {
+    return false;
+  }
+
+  unsigned long t_now = millis();
+  if (t_now - windowStart >= window)
+  {
+    windowStart = t_now;
+    spent = 0;
+  }
+  if (spent >= budget)
+  {
+    return false;
+  }
+  spent++;
+  return true;
+}
+
+unsigned long SupabaseRetryPolicy::backoff(uint8_t attempt)
+{
+  unsigned long cap = baseDelay;
+  for (uint8_t i = 0; i < attempt && cap < maxDelay; i++)
+  {
+    cap <<= 1;
+  }
+  if (cap > maxDelay)
+  {
+    cap = maxDelay;
+  }
+  return random(0, cap + 1);
+}
+
+bool SupabaseRetryPolicy::retryable(int httpCode)
+{
+  return httpCode <= 0 || httpCode == 408 || httpCode == 429 || httpCode == 502 || httpCode == 503 || httpCode == 504;
+}
+
+bool SupabaseRetryPolicy::idempotent(const char *method)
+{
+  return strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0 || strcmp(method, "PUT") == 0 || strcmp(method, "DELETE") == 0;
+}
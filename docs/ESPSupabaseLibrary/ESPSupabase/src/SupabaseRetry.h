@@ -0,0 +1,35 @@
+#ifndef ESP_Supabase_Retry_h
+#define ESP_Supabase_Retry_h
+
+#include <Arduino.h>
+
+// Bounded retry with exponential backoff and full jitter.
+// One instance can be shared by several clients (e.g. Supabase and
+// SupabaseRealtime), they then draw from the same retry budget.
+class SupabaseRetryPolicy
+{
+private:
+  uint8_t maxAttempts;
+  unsigned long baseDelay;
+  unsigned long maxDelay;
+  uint16_t budget;
+  unsigned long window;
+  uint16_t spent = 0;
+  unsigned long windowStart = 0;
+
+public:
+  // budget is the number of retries allowed in every window (ms)
+  SupabaseRetryPolicy(uint8_t maxAttempts_a = 5, unsigned long baseDelay_a = 500, unsigned long maxDelay_a = 30000, uint16_t budget_a = 20, unsigned long window_a = 60000);
+
+  // attempt is the number of attempts already made, takes one retry out of the budget
+  bool shouldRetry(uint8_t attempt);
+  // random delay between 0 and min(maxDelay, baseDelay * 2^attempt)
+  unsigned long backoff(uint8_t attempt);
+
+  // transport errors, timeouts, rate limiting and gateway errors
+  static bool retryable(int httpCode);
+  // methods that can be sent twice without a different outcome
+  static bool idempotent(const char *method);
+};
+
+#endif
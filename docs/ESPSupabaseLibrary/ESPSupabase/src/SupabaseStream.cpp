@@ -0,0 +1,215 @@
+#include "SupabaseStream.h"
+
+SupabaseBodyStream::SupabaseBodyStream()
+{
+  client = nullptr;
+  state = DONE;
+  chunked = false;
+  untilClose = false;
+  remaining = 0;
+  consumed = 0;
+  trailerLineEmpty = true;
+  peeked = -1;
+}
+
+SupabaseBodyStream::SupabaseBodyStream(Client &client_a, int size, bool chunked_a)
+{
+  begin(client_a, size, chunked_a);
+}
+
+void SupabaseBodyStream::begin(Client &client_a, int size, bool chunked_a)
+{
+  client = &client_a;
+  chunked = chunked_a;
+  untilClose = !chunked && size < 0;
+  remaining = size > 0 ? size : 0;
+  consumed = 0;
+  trailerLineEmpty = true;
+  peeked = -1;
+
+  if (chunked)
+  {
+    state = CHUNK_SIZE;
+  }
+  else
+  {
+    state = (untilClose || remaining > 0) ? BODY : DONE;
+  }
+}
+
+// Consumes chunk framing until payload bytes are next on the wire.
+// Returns false when no more input is available right now.
+bool SupabaseBodyStream::_advance()
+{
+  while (state != CHUNK_DATA && state != BODY && state != DONE)
+  {
+    int c = client->read();
+    if (c < 0)
+    {
+      return false;
+    }
+
+    switch (state)
+    {
+    case CHUNK_SIZE:
+      if (c >= '0' && c <= '9')
+        remaining = (remaining << 4) | (c - '0');
+      else if (c >= 'a' && c <= 'f')
+        remaining = (remaining << 4) | (c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F')
+        remaining = (remaining << 4) | (c - 'A' + 10);
+      else if (c == '\r')
+        state = CHUNK_SIZE_LF;
+      else
+        state = CHUNK_EXT;
+      break;
+    case CHUNK_EXT:
+      if (c == '\r')
+        state = CHUNK_SIZE_LF;
+      break;
+    case CHUNK_SIZE_LF:
+      if (remaining == 0)
+      {
+        trailerLineEmpty = true;
+        state = TRAILER;
+      }
+      else
+      {
+        state = CHUNK_DATA;
+      }
+      break;
+    case CHUNK_DATA_CR:
+      state = CHUNK_DATA_LF;
+      break;
+    case CHUNK_DATA_LF:
+      remaining = 0;
+      state = CHUNK_SIZE;
+      break;
+    case TRAILER:
+      if (c == '\r')
+        state = TRAILER_LF;
+      else
+        trailerLineEmpty = false;
+      break;
+    case TRAILER_LF:
+      if (trailerLineEmpty)
+      {
+        state = DONE;
+      }
+      else
+      {
+        trailerLineEmpty = true;
+        state = TRAILER;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return state != DONE;
+}
+
+int SupabaseBodyStream::_read()
+{
+  if (!_advance())
+  {
+    return -1;
+  }
+
+  int c = client->read();
+  if (c < 0)
+  {
+    return -1;
+  }
+  consumed++;
+
+  if (state == CHUNK_DATA)
+  {
+    if (--remaining == 0)
+    {
+      state = CHUNK_DATA_CR;
+    }
+  }
+  else if (!untilClose && --remaining == 0)
+  {
+    state = DONE;
+  }
+  return c;
+}
+
+int SupabaseBodyStream::available()
+{
+  if (peeked >= 0)
+  {
+    return 1;
+  }
+  if (!_advance())
+  {
+    return 0;
+  }
+
+  int n = client->available();
+  if (!untilClose && (uint32_t)n > remaining)
+  {
+    n = remaining;
+  }
+  return n;
+}
+
+int SupabaseBodyStream::read()
+{
+  if (peeked >= 0)
+  {
+    int c = peeked;
+    peeked = -1;
+    return c;
+  }
+  return _read();
+}
+
+int SupabaseBodyStream::peek()
+{
+  if (peeked < 0)
+  {
+    peeked = _read();
+  }
+  return peeked;
+}
+
+size_t SupabaseBodyStream::write(uint8_t)
+{
+  return 0;
+}
+
+bool SupabaseBodyStream::drain(unsigned long timeout)
+{
+  peeked = -1;
+  unsigned long start = millis();
+  while (!finished())
+  {
+    if (_read() < 0)
+    {
+      if (untilClose && !client->connected())
+      {
+        state = DONE;
+        break;
+      }
+      if (millis() - start >= timeout)
+      {
+        return false;
+      }
+      delay(1);
+    }
+  }
+  return true;
+}
+
+bool SupabaseBodyStream::finished()
+{
+  return peeked < 0 && state == DONE;
+}
+
+uint32_t SupabaseBodyStream::bytesRead()
+{
+  return consumed;
+}
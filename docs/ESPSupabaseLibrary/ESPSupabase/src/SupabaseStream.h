@@ -0,0 +1,56 @@
+#ifndef ESP_Supabase_Stream_h
+#define ESP_Supabase_Stream_h
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Response body as a Stream, read straight from the connection.
+// Handles Content-Length and chunked bodies so the parser only sees the
+// payload, and so the connection is left at the start of the next response.
+class SupabaseBodyStream : public Stream
+{
+private:
+  enum State
+  {
+    CHUNK_SIZE,
+    CHUNK_EXT,
+    CHUNK_SIZE_LF,
+    CHUNK_DATA,
+    CHUNK_DATA_CR,
+    CHUNK_DATA_LF,
+    TRAILER,
+    TRAILER_LF,
+    BODY,
+    DONE
+  };
+
+  Client *client;
+  State state;
+  bool chunked;
+  bool untilClose;
+  uint32_t remaining;
+  uint32_t consumed;
+  bool trailerLineEmpty;
+  int peeked;
+
+  bool _advance();
+  int _read();
+
+public:
+  SupabaseBodyStream();
+  // size is the Content-Length, -1 if unknown
+  SupabaseBodyStream(Client &client_a, int size, bool chunked_a);
+  void begin(Client &client_a, int size, bool chunked_a);
+
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t);
+
+  // reads and discards the rest of the body, false on timeout
+  bool drain(unsigned long timeout = 5000);
+  bool finished();
+  uint32_t bytesRead();
+};
+
+#endif
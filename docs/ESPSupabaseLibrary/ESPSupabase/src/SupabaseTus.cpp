@@ -0,0 +1,305 @@
+#include "ESPSupabase.h"
+
+// Resumable uploads with the TUS protocol (https://tus.io) of Supabase Storage
+
+static const char *tusPath = "/storage/v1/upload/resumable";
+
+static String base64(const String &in)
+{
+  static const char *table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  String out;
+  out.reserve((in.length() + 2) / 3 * 4);
+  for (unsigned int i = 0; i < in.length(); i += 3)
+  {
+    uint32_t n = (uint8_t)in[i] << 16;
+    if (i + 1 < in.length())
+      n |= (uint8_t)in[i + 1] << 8;
+    if (i + 2 < in.length())
+      n |= (uint8_t)in[i + 2];
+
+    out += table[(n >> 18) & 63];
+    out += table[(n >> 12) & 63];
+    out += i + 1 < in.length() ? table[(n >> 6) & 63] : '=';
+    out += i + 2 < in.length() ? table[n & 63] : '=';
+  }
+  return out;
+}
+
+void Supabase::setResumableChunk(uint32_t size)
+{
+  tusChunk = size > 0 ? size : 6 * 1024 * 1024;
+}
+
+String Supabase::_tusHeaders(const char *method, const String &path)
+{
+  String header = String(method) + " " + path + " HTTP/1.1\r\n";
+  header += "Host: " + host + "\r\n";
+  header += "apikey: " + key + "\r\n";
+  if (useAuth)
+  {
+    header += "Authorization: Bearer " + USER_TOKEN + "\r\n";
+  }
+  header += "Tus-Resumable: 1.0.0\r\n";
+  header += "User-Agent: ESP32/Supabase\r\n";
+  header += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  return header;
+}
+
+// Sends a request without body and reads the headers named in keys
+int Supabase::_tusRequest(const String &header, bool head, const char *const *keys, String *values, uint8_t count)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  _check_auth();
+  if (metrics)
+  {
+    requestTimer.begin(*metrics, header.c_str());
+  }
+  bool reused = false;
+  if (!_rawConnect(&reused))
+  {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  int httpCode = HTTPC_ERROR_SEND_HEADER_FAILED;
+  SupabaseBodyStream body;
+  bool close = true;
+  if (client.write((const uint8_t *)header.c_str(), header.length()) == header.length())
+  {
+    if (metrics)
+    {
+      requestTimer.bytes(header.length(), 0);
+    }
+    httpCode = _rawResponse(body, close, head, keys, values, count);
+  }
+  if (httpCode > 0 && !body.drain())
+  {
+    close = true;
+  }
+  _rawEnd(close || httpCode <= 0);
+
+  // a kept-alive connection the server closed while it was idle, once more on a new one
+  if (reused && (httpCode == HTTPC_ERROR_SEND_HEADER_FAILED || httpCode == HTTPC_ERROR_CONNECTION_LOST))
+  {
+    connectionStats.reconnects++;
+    return _tusRequest(header, head, keys, values, count);
+  }
+  return httpCode;
+}
+
+// Creates the upload, location is its path on the server
+int Supabase::_tusCreate(String bucket, String filename, String mime_type, uint32_t size, String &location)
+{
+  String header = _tusHeaders("POST", tusPath);
+  header += "Upload-Length: " + String(size) + "\r\n";
+  header += "Upload-Metadata: bucketName " + base64(bucket) + ",objectName " + base64(filename) + ",contentType " + base64(mime_type) + "\r\n";
+  header += "Content-Length: 0\r\n\r\n";
+
+  static const char *keys[] = {"location"};
+  String url;
+  int httpCode = _tusRequest(header, false, keys, &url, 1);
+  if (httpCode != 201)
+  {
+    return httpCode;
+  }
+
+  // the server answers with an absolute URL, keep its path
+  int index = url.indexOf("//");
+  index = index >= 0 ? url.indexOf('/', index + 2) : 0;
+  location = index >= 0 ? url.substring(index) : "";
+  return location.length() > 0 ? httpCode : HTTPC_ERROR_NO_HTTP_SERVER;
+}
+
+// Asks the server how much of the upload it has
+int Supabase::_tusOffset(const String &location, uint32_t &offset)
+{
+  String header = _tusHeaders("HEAD", location) + "\r\n";
+
+  static const char *keys[] = {"upload-offset"};
+  String value;
+  int httpCode = _tusRequest(header, true, keys, &value, 1);
+  if (httpCode == 200 || httpCode == 204)
+  {
+    offset = strtoul(value.c_str(), nullptr, 10);
+  }
+  return httpCode;
+}
+
+// Sends length bytes of file from offset, offset is moved to what the server confirmed
+int Supabase::_tusPatch(const String &location, fs::File &file, uint32_t &offset, uint32_t length)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  _check_auth();
+
+  String header = _tusHeaders("PATCH", location);
+  header += "Upload-Offset: " + String(offset) + "\r\n";
+  header += "Content-Type: application/offset+octet-stream\r\n";
+  header += "Content-Length: " + String(length) + "\r\n\r\n";
+
+  uint8_t stackBuffer[SUPABASE_UPLOAD_BUFFER];
+  static const char *keys[] = {"upload-offset"};
+  String value;
+  SupabaseBodyStream body;
+  bool close = true;
+  int httpCode;
+  unsigned long start = millis();
+  for (bool resent = false;; resent = true)
+  {
+    if (!file.seek(offset))
+    {
+      return HTTPC_ERROR_NO_STREAM;
+    }
+    if (metrics)
+    {
+      requestTimer.begin(*metrics, header.c_str());
+    }
+    bool reused = false;
+    if (!_rawConnect(&reused))
+    {
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    SupabaseUploadWriter writer(client, uploadBuffer ? uploadBuffer : stackBuffer, uploadBuffer ? uploadBufferSize : sizeof(stackBuffer));
+    writer.put(header);
+    if (!writer.putStream(file, length) || !writer.flush())
+    {
+      httpCode = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    else
+    {
+      if (metrics)
+      {
+        requestTimer.bytes(writer.bytesSent(), 0);
+      }
+      httpCode = _rawResponse(body, close, false, keys, &value, 1);
+    }
+    if (httpCode > 0 && !body.drain())
+    {
+      close = true;
+    }
+    _rawEnd(close || httpCode <= 0);
+    uploadStats.bytes += writer.bytesSent();
+
+    // The server closed the kept-alive connection while it was idle and no
+    // response came back: the chunk is sent once more on a new one. A part
+    // that did arrive is answered with 409 and resumed from its offset
+    bool lost = !writer.ok() || httpCode == HTTPC_ERROR_CONNECTION_LOST;
+    if (reused && !resent && lost)
+    {
+      connectionStats.reconnects++;
+      continue;
+    }
+    break;
+  }
+
+  uploadStats.duration += millis() - start;
+  uploadStats.bytesPerSecond = uploadStats.duration > 0 ? (uint64_t)uploadStats.bytes * 1000 / uploadStats.duration : uploadStats.bytes;
+
+  if (httpCode == 204)
+  {
+    offset = strtoul(value.c_str(), nullptr, 10);
+  }
+  return httpCode;
+}
+
+int Supabase::uploadResumable(String bucket, String filename, String mime_type, fs::File &file, fs::FS &stateFs, String statePath)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  uint32_t size = file.size();
+  uint32_t offset = 0;
+  String location;
+
+  // the state file holds what is uploaded and where, it is only valid for the same file
+  String fingerprint = bucket + "/" + filename + " " + String(size);
+  if (stateFs.exists(statePath))
+  {
+    File state = stateFs.open(statePath, "r");
+    if (state)
+    {
+      String saved = state.readStringUntil('\n');
+      if (saved == fingerprint)
+      {
+        location = state.readStringUntil('\n');
+      }
+      state.close();
+    }
+  }
+
+  uploadStats = SupabaseUploadStats();
+
+  int httpCode = 0;
+  uint8_t restarts = 0; // not reset by progress, an upload that keeps expiring gives up
+  for (uint8_t attempt = 1;; attempt++)
+  {
+    if (location.length() == 0)
+    {
+      httpCode = _tusCreate(bucket, filename, mime_type, size, location);
+      if (httpCode == 201)
+      {
+        offset = 0;
+        File state = stateFs.open(statePath, "w");
+        if (state)
+        {
+          state.print(fingerprint + "\n" + location + "\n");
+          state.close();
+        }
+      }
+    }
+    else
+    {
+      httpCode = _tusOffset(location, offset);
+      if (httpCode == 200 || httpCode == 204)
+      {
+        Serial.printf("Resuming upload at %u of %u bytes\n", offset, size);
+      }
+    }
+
+    while ((httpCode == 200 || httpCode == 201 || httpCode == 204) && offset < size)
+    {
+      uint32_t length = size - offset < tusChunk ? size - offset : tusChunk;
+      uint32_t before = offset;
+      httpCode = _tusPatch(location, file, offset, length);
+      if (httpCode == 204 && offset > before)
+      {
+        // progress, the retry attempts start over
+        attempt = 1;
+      }
+      else if (httpCode == 204)
+      {
+        httpCode = HTTPC_ERROR_CONNECTION_LOST;
+      }
+    }
+
+    if ((httpCode == 200 || httpCode == 201 || httpCode == 204) && offset >= size)
+    {
+      stateFs.remove(statePath);
+      Serial.printf("Uploaded %u bytes in %lu ms (%u B/s)\n", uploadStats.bytes, uploadStats.duration, uploadStats.bytesPerSecond);
+      // a 0 byte file is done with the create (201), a resumed one may be with the HEAD (200)
+      return 204;
+    }
+
+    if ((httpCode == 404 || httpCode == 410) && location.length() > 0)
+    {
+      // the server forgot the upload (expired), start over
+      location = "";
+      offset = 0;
+      stateFs.remove(statePath);
+      restarts++;
+      if (!_retry().shouldRetry(restarts))
+      {
+        Serial.printf("Resumable upload expired too often (%d)\n", httpCode);
+        return httpCode;
+      }
+      Serial.println("Resumable upload expired, starting over");
+      delay(_retry().backoff(restarts));
+      continue;
+    }
+
+    // 409 on PATCH is an offset mismatch, asking for the offset again resolves it
+    bool mismatch = httpCode == 409 && location.length() > 0;
+    if ((!SupabaseRetryPolicy::retryable(httpCode) && !mismatch) || !_retry().shouldRetry(attempt))
+    {
+      Serial.printf("Resumable upload stopped at %u of %u bytes (%d)\n", offset, size, httpCode);
+      return httpCode;
+    }
+    delay(_retry().backoff(attempt));
+  }
+}
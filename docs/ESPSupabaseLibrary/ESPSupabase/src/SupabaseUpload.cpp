@@ -0,0 +1,436 @@
+#include "ESPSupabase.h"
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+SupabaseUploadWriter::SupabaseUploadWriter(Client &client_a, uint8_t *buffer_a, size_t size_a)
+    : client(client_a), buffer(buffer_a), size(size_a)
+{
+}
+
+bool SupabaseUploadWriter::put(const uint8_t *data, size_t len)
+{
+  while (len > 0 && !failed)
+  {
+    if (used == 0 && len >= size)
+    {
+      // nothing to coalesce with, skip the copy
+      if (client.write(data, len) != len)
+      {
+        failed = true;
+        break;
+      }
+      sent += len;
+      break;
+    }
+
+    size_t n = size - used;
+    if (n > len)
+    {
+      n = len;
+    }
+    memcpy(buffer + used, data, n);
+    data += n;
+    len -= n;
+    commit(n);
+  }
+  return !failed;
+}
+
+bool SupabaseUploadWriter::put(const String &s)
+{
+  return put((const uint8_t *)s.c_str(), s.length());
+}
+
+uint8_t *SupabaseUploadWriter::space(size_t &len)
+{
+  len = size - used;
+  return buffer + used;
+}
+
+bool SupabaseUploadWriter::commit(size_t len)
+{
+  used += len;
+  if (used >= size)
+  {
+    return flush();
+  }
+  return !failed;
+}
+
+bool SupabaseUploadWriter::flush()
+{
+  if (used > 0 && !failed)
+  {
+    if (client.write(buffer, used) != used)
+    {
+      failed = true;
+    }
+    else
+    {
+      sent += used;
+    }
+  }
+  used = 0;
+  return !failed;
+}
+
+bool SupabaseUploadWriter::putStream(Stream &source, uint32_t size_a)
+{
+  uint32_t remaining = size_a;
+  while (remaining > 0 && !failed)
+  {
+    size_t n;
+    uint8_t *p = space(n);
+    if (n > remaining)
+    {
+      n = remaining;
+    }
+
+    // readBytes waits up to the stream timeout, a slow SD card or a momentarily
+    // empty available() doesn't end the upload early
+    size_t got = source.readBytes(p, n);
+    if (got == 0)
+    {
+      return false;
+    }
+    commit(got);
+    remaining -= got;
+  }
+  return !failed;
+}
+
+bool SupabaseUploadWriter::ok()
+{
+  return !failed;
+}
+
+uint32_t SupabaseUploadWriter::bytesSent()
+{
+  return sent;
+}
+
+void Supabase::setUploadBuffer(uint8_t *buffer, size_t size)
+{
+  uploadBuffer = size > 0 ? buffer : nullptr;
+  uploadBufferSize = uploadBuffer ? size : 0;
+}
+
+SupabaseUploadStats Supabase::getUploadStats()
+{
+  return uploadStats;
+}
+
+// Opens the connection for a request written by hand, reusing the kept-alive
+// one when it is still fresh
+bool Supabase::_rawConnect(bool *reused)
+{
+  if (client.connected() && (!keepAlive || millis() - lastActivity >= keepAliveIdleTimeout))
+  {
+    client.stop();
+    if (keepAlive)
+    {
+      connectionStats.idleCloses++;
+    }
+  }
+
+  if (client.connected())
+  {
+    connectionStats.reused++;
+    if (reused)
+    {
+      *reused = true;
+    }
+    if (metrics)
+    {
+      requestTimer.reused(true);
+    }
+    return true;
+  }
+
+  if (metrics)
+  {
+    // resolved on its own so the lookup is timed apart, connect() finds it cached
+    IPAddress ip;
+    WiFi.hostByName(host.c_str(), ip);
+    requestTimer.mark(SupabaseMetrics::DNS);
+  }
+  bool connected = client.connect(host.c_str(), 443);
+  if (metrics)
+  {
+    requestTimer.mark(SupabaseMetrics::CONNECT);
+    if (!connected)
+    {
+      requestTimer.response(HTTPC_ERROR_CONNECTION_REFUSED);
+      requestTimer.end();
+    }
+  }
+  if (!connected)
+  {
+    return false;
+  }
+  connectionStats.opened++;
+  return true;
+}
+
+// Reads the status line and headers of a response to a request written by
+// hand, and sets up body to read what follows (nothing for head). The values of
+// the headers named in keys (lower case) are stored in values.
+int Supabase::_rawResponse(SupabaseBodyStream &body, bool &close, bool head, const char *const *keys, String *values, uint8_t count)
+{
+  int httpCode = 0;
+  int length = -1;
+  bool chunked = false;
+  close = !keepAlive;
+
+  if (metrics)
+  {
+    requestTimer.mark(SupabaseMetrics::SEND);
+  }
+  client.setTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT);
+  while (true)
+  {
+    String line = client.readStringUntil('\n');
+    line.trim();
+
+    if (httpCode == 0)
+    {
+      if (line.length() == 0)
+      {
+        if (client.available() > 0)
+        {
+          continue;
+        }
+        httpCode = client.connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+        break;
+      }
+      // HTTP/1.1 200 OK
+      int codePos = line.indexOf(' ') + 1;
+      httpCode = line.substring(codePos, codePos + 3).toInt();
+      if (httpCode <= 0)
+      {
+        httpCode = HTTPC_ERROR_NO_HTTP_SERVER;
+        break;
+      }
+      continue;
+    }
+
+    if (line.length() == 0)
+    {
+      if (httpCode >= 100 && httpCode < 200)
+      {
+        // interim response, the real one follows
+        httpCode = 0;
+        continue;
+      }
+      break;
+    }
+
+    int colon = line.indexOf(':');
+    if (colon <= 0)
+    {
+      continue;
+    }
+    String name = line.substring(0, colon);
+    String value = line.substring(colon + 1);
+    name.toLowerCase();
+    value.trim();
+
+    if (name == "content-length")
+    {
+      length = value.toInt();
+    }
+    else if (name == "transfer-encoding")
+    {
+      chunked = value.equalsIgnoreCase("chunked");
+    }
+    else if (name == "connection")
+    {
+      close = close || value.equalsIgnoreCase("close");
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+      if (name == keys[i])
+      {
+        values[i] = value;
+      }
+    }
+  }
+
+  if (metrics)
+  {
+    requestTimer.response(httpCode);
+  }
+  if (httpCode <= 0)
+  {
+    return httpCode;
+  }
+
+  bool noBody = head || httpCode == 204 || httpCode == 304;
+  body.begin(client, noBody ? 0 : length, !noBody && chunked);
+  body.setTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT);
+  if (length < 0 && !chunked && !noBody)
+  {
+    // body delimited by the connection close
+    close = true;
+  }
+  return httpCode;
+}
+
+// Ends a request written by hand, the connection stays open for the next one
+// unless keep-alive is off or the server is closing it
+void Supabase::_rawEnd(bool close)
+{
+  if (close)
+  {
+    client.stop();
+  }
+  lastActivity = millis();
+  if (metrics)
+  {
+    requestTimer.end();
+  }
+}
+
+// One pipeline for both upload() overloads: headers, multipart preamble and
+// body go through one reusable buffer, data (in RAM) or stream is the body.
+int Supabase::_upload(String bucket, String filename, String mime_type, const uint8_t *data, Stream *stream, uint32_t size)
+{
+  SupabaseHeapScope heap(SupabaseHeap::REST);
+  _check_auth();
+
+  const char *boundary = "esp32-supabase-boundary";
+
+  // request Content Header
+  String contentHeader = "--";
+  contentHeader += boundary;
+  contentHeader += "\r\nContent-Disposition: form-data; name=\"" + filename + "\"; filename=\"" + filename + "\"\r\n";
+  contentHeader += "Content-Type: " + mime_type + "\r\n\r\n";
+
+  // request Ending Header
+  String endingHeader = "\r\n--";
+  endingHeader += boundary;
+  endingHeader += "--\r\n";
+
+  // Request Main Header
+  String httpMainHeader;
+  httpMainHeader.reserve(200 + bucket.length() + filename.length() + host.length() + key.length() + (useAuth ? USER_TOKEN.length() : 0));
+  httpMainHeader += "POST /storage/v1/object/" + bucket + "/" + filename + " HTTP/1.1\r\n";
+  httpMainHeader += "Host: " + host + "\r\n";
+  httpMainHeader += "apikey: " + key + "\r\n";
+  httpMainHeader += "Content-Type: multipart/form-data; boundary=";
+  httpMainHeader += boundary;
+  httpMainHeader += "\r\n";
+  if (useAuth)
+  {
+    httpMainHeader += "Authorization: Bearer " + USER_TOKEN + "\r\n";
+  }
+  httpMainHeader += "User-Agent: ESP32/Supabase\r\n";
+  httpMainHeader += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  httpMainHeader += "Content-Length: " + String(contentHeader.length() + size + endingHeader.length()) + "\r\n\r\n";
+
+  uint8_t stackBuffer[SUPABASE_UPLOAD_BUFFER];
+  uploadStats = SupabaseUploadStats();
+
+  SupabaseBodyStream body;
+  bool close = true;
+  int httpCode;
+  uint32_t sent;
+  unsigned long start;
+  for (bool resent = false;; resent = true)
+  {
+    if (metrics)
+    {
+      requestTimer.begin(*metrics, "/storage/v1/object/");
+    }
+    bool reused = false;
+    if (!_rawConnect(&reused))
+    {
+      Serial.println("Upload failed: could not connect");
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    start = millis();
+
+    SupabaseUploadWriter writer(client, uploadBuffer ? uploadBuffer : stackBuffer, uploadBuffer ? uploadBufferSize : sizeof(stackBuffer));
+    writer.put(httpMainHeader);
+    writer.put(contentHeader);
+    // A stream can't be rewound. On a reused connection the preamble goes out
+    // first, so a stale one fails before anything is read from the stream
+    bool streamed = false;
+    if (data)
+    {
+      writer.put(data, size);
+    }
+    else if (!reused || writer.flush())
+    {
+      streamed = true;
+      if (!writer.putStream(*stream, size) && writer.ok())
+      {
+        // Content-Length can't be honoured anymore, the request is lost
+        Serial.printf("Upload failed: source ended after %u of %u bytes\n", writer.bytesSent(), size);
+        _rawEnd(true);
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+      }
+    }
+    writer.put(endingHeader);
+
+    httpCode = writer.flush() ? _rawResponse(body, close) : HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    sent = writer.bytesSent();
+
+    // The server closed the kept-alive connection while it was idle and no
+    // response came back: sent once more on a new one, when the body can be
+    if (reused && !resent && !streamed && (httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED || httpCode == HTTPC_ERROR_CONNECTION_LOST))
+    {
+      _rawEnd(true);
+      connectionStats.reconnects++;
+      continue;
+    }
+    break;
+  }
+
+  if (httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED)
+  {
+    Serial.println("Upload failed: connection lost");
+    _rawEnd(true);
+    return httpCode;
+  }
+
+  uploadStats.bytes = sent;
+  uploadStats.duration = millis() - start;
+  if (metrics)
+  {
+    requestTimer.bytes(sent, 0);
+  }
+  uploadStats.bytesPerSecond = uploadStats.duration > 0 ? (uint64_t)uploadStats.bytes * 1000 / uploadStats.duration : uploadStats.bytes;
+
+  if (httpCode > 0)
+  {
+    String response = body.readString();
+    if (!body.finished())
+    {
+      close = true;
+    }
+    if (metrics)
+    {
+      requestTimer.bytes(0, body.bytesRead());
+    }
+    Serial.printf("Upload response (%d): %s\n", httpCode, response.c_str());
+  }
+  Serial.printf("Uploaded %u bytes in %lu ms (%u B/s)\n", uploadStats.bytes, uploadStats.duration, uploadStats.bytesPerSecond);
+
+  _rawEnd(close || httpCode <= 0);
+  return httpCode;
+}
+
+int Supabase::upload(String bucket, String filename, String mime_type, uint8_t *buffer, uint32_t size)
+{
+  return _upload(bucket, filename, mime_type, buffer, nullptr, size);
+}
+
+int Supabase::upload(String bucket, String filename, String mime_type, Stream *stream, uint32_t size)
+{
+  return _upload(bucket, filename, mime_type, nullptr, stream, size);
+}
@@ -0,0 +1,53 @@
+#ifndef ESP_Supabase_Upload_h
+#define ESP_Supabase_Upload_h
+
+#include <Arduino.h>
+#include <Client.h>
+
+#ifndef SUPABASE_UPLOAD_BUFFER
+// stack buffer of upload(), execute() and uploadResumable() when no buffer was
+// given with setUploadBuffer()
+#define SUPABASE_UPLOAD_BUFFER 512
+#endif
+
+// Throughput of the last upload
+struct SupabaseUploadStats
+{
+  uint32_t bytes = 0;          // request bytes written, headers included
+  unsigned long duration = 0;  // ms from the first write to the response status
+  uint32_t bytesPerSecond = 0;
+};
+
+// Gathers headers, multipart preamble and body into one buffer, so they leave
+// in as few TLS records as possible. Pieces at least as large as the buffer
+// are written straight through without a copy.
+class SupabaseUploadWriter
+{
+private:
+  Client &client;
+  uint8_t *buffer;
+  size_t size;
+  size_t used = 0;
+  uint32_t sent = 0;
+  bool failed = false;
+
+public:
+  SupabaseUploadWriter(Client &client_a, uint8_t *buffer_a, size_t size_a);
+
+  bool put(const uint8_t *data, size_t len);
+  bool put(const String &s);
+  // free space at the end of the buffer, to read the body straight into it
+  uint8_t *space(size_t &len);
+  // marks len bytes written into space() as used
+  bool commit(size_t len);
+  bool flush();
+
+  // copies the source into the buffer until size bytes are consumed,
+  // false if the source ran dry (readBytes timed out) or a write failed
+  bool putStream(Stream &source, uint32_t size);
+
+  bool ok();
+  uint32_t bytesSent();
+};
+
+#endif
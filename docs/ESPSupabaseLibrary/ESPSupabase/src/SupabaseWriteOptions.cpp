@@ -0,0 +1,58 @@
+#include "SupabaseWriteOptions.h"
+
+SupabaseWriteOptions &SupabaseWriteOptions::returning(Return mode)
+{
+  returnMode = mode;
+  return *this;
+}
+
+SupabaseWriteOptions &SupabaseWriteOptions::missingDefault(bool enable)
+{
+  missing = enable;
+  return *this;
+}
+
+SupabaseWriteOptions &SupabaseWriteOptions::upsert(bool enable)
+{
+  merge = enable;
+  return *this;
+}
+
+SupabaseWriteOptions &SupabaseWriteOptions::columns(const char *list)
+{
+  // copied, the options may outlive the string (beginBatch() keeps them)
+  columnList = list ? list : "";
+  return *this;
+}
+
+String SupabaseWriteOptions::prefer() const
+{
+  String header;
+  switch (returnMode)
+  {
+  case MINIMAL:
+    header = "return=minimal";
+    break;
+  case HEADERS_ONLY:
+    header = "return=headers-only";
+    break;
+  case REPRESENTATION:
+    header = "return=representation";
+    break;
+  }
+  if (merge)
+  {
+    header += ",resolution=merge-duplicates";
+  }
+  if (missing)
+  {
+    header += ",missing=default";
+  }
+  return header;
+}
+
+// nullptr when every column is read
+const char *SupabaseWriteOptions::getColumns() const
+{
+  return columnList.length() > 0 ? columnList.c_str() : nullptr;
+}
@@ -0,0 +1,39 @@
+#ifndef ESP_Supabase_Write_Options_h
+#define ESP_Supabase_Write_Options_h
+
+#include <Arduino.h>
+
+// How PostgREST should handle an insert or update (the Prefer header and the
+// columns parameter). Built like the queries:
+//   SupabaseWriteOptions().returning(SupabaseWriteOptions::MINIMAL).missingDefault()
+class SupabaseWriteOptions
+{
+public:
+  enum Return : uint8_t
+  {
+    MINIMAL,        // nothing comes back (the default)
+    HEADERS_ONLY,   // only the Location header
+    REPRESENTATION  // the written rows come back
+  };
+
+private:
+  Return returnMode = MINIMAL;
+  bool missing = false;
+  bool merge = false;
+  String columnList;
+
+public:
+  SupabaseWriteOptions &returning(Return mode);
+  // columns missing from the payload get their default instead of NULL
+  SupabaseWriteOptions &missingDefault(bool enable = true);
+  // insert only: update rows whose primary key already exists
+  SupabaseWriteOptions &upsert(bool enable = true);
+  // only these columns (comma separated) are read from the payload, saves
+  // PostgREST from scanning every object of a bulk insert for its keys
+  SupabaseWriteOptions &columns(const char *list);
+
+  String prefer() const;
+  const char *getColumns() const;
+};
+
+#endif
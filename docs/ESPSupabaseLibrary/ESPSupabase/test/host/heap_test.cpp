@@ -0,0 +1,137 @@
+// Counting allocator: steady requests must free what they allocate, and with
+// the malloc hooks (-Wl,--wrap) C allocations are counted as well
+#include "ESPSupabase.h"
+#include "SupabaseHeapCounting.h"
+
+static int failures = 0;
+#define CHECK(cond)                                              \
+  do                                                             \
+  {                                                              \
+    if (!(cond))                                                 \
+    {                                                            \
+      printf("  FAIL %s:%d %s\n", __FILE__, __LINE__, #cond);    \
+      failures++;                                                \
+    }                                                            \
+  } while (0)
+
+// answers every request with a small JSON array
+struct JsonServer : MockServer
+{
+  std::string handle(const std::string &head, const std::string &body) override
+  {
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 9\r\n\r\n[{\"a\":1}]";
+  }
+};
+
+struct Line : Print
+{
+  std::string s;
+  size_t write(uint8_t c) override
+  {
+    s += (char)c;
+    return 1;
+  }
+};
+
+static Supabase db;
+
+static void mallocHooks()
+{
+  printf("malloc, realloc and free are counted\n");
+  SupabaseHeap::reset();
+  {
+    SupabaseHeapScope scope(SupabaseHeap::REALTIME);
+    char *block = (char *)malloc(100);
+    block = (char *)realloc(block, 300);
+    char *zeroed = (char *)calloc(4, 25);
+    CHECK(zeroed[99] == 0);
+    free(zeroed);
+    free(block);
+    // Arduino String allocates with malloc
+    String text = "a string longer than any small string buffer";
+    text += " and then some";
+  }
+  const SupabaseHeapStats &s = SupabaseHeap::stats(SupabaseHeap::REALTIME);
+  CHECK(s.allocations >= 4);
+  CHECK(s.allocations == s.frees);
+  CHECK(s.live == 0);
+  CHECK(s.peak >= 400);
+
+  // a block allocated inside libc is freed by the wrapped free()
+  char *copy = strdup("allocated by libc");
+  free(copy);
+
+  // many live blocks freed out of order keep the address table consistent
+  SupabaseHeap::reset();
+  {
+    SupabaseHeapScope scope(SupabaseHeap::REALTIME);
+    static void *blocks[20000];
+    for (int i = 0; i < 20000; i++)
+    {
+      blocks[i] = malloc(1 + i % 64);
+    }
+    for (int i = 0; i < 20000; i += 2)
+    {
+      free(blocks[i]);
+    }
+    for (int i = 1; i < 20000; i += 2)
+    {
+      blocks[i] = realloc(blocks[i], 100);
+      free(blocks[i]);
+    }
+  }
+  CHECK(s.allocations == s.frees);
+  CHECK(s.live == 0);
+}
+
+static void steadyRequests()
+{
+  printf("steady requests free what they allocate\n");
+  db.setKeepAlive(true);
+  SupabasePrepared poll = db.prepare("GET", "/rest/v1/device_commands?executed=eq.false");
+  auto done = [](int httpCode, String &body) {};
+
+  SupabaseHeapStats rounds[4];
+  for (int round = 0; round < 4; round++)
+  {
+    SupabaseHeap::reset();
+    db.submit("GET", "/rest/v1/device_commands", "", done);
+    db.submit("POST", "/rest/v1/co_readings", "{\"ppm\":12}", done);
+    for (int i = 0; i < 20000 && db.busy(); i++)
+    {
+      db.poll();
+    }
+    String out;
+    CHECK(db.execute(poll, "", &out) == 200);
+    CHECK(out == "[{\"a\":1}]");
+    rounds[round] = SupabaseHeap::stats(SupabaseHeap::REST);
+  }
+
+  Line line;
+  SupabaseHeap::printTo(line);
+  printf("  %s", line.s.c_str());
+  // the first round opens the connection, after it every round is the same
+  for (int round = 2; round < 4; round++)
+  {
+    CHECK(rounds[round].allocations == rounds[1].allocations);
+    CHECK(rounds[round].allocations == rounds[round].frees);
+    CHECK(rounds[round].live == 0);
+  }
+  db.disconnect();
+}
+
+int main()
+{
+  JsonServer server;
+  mockServer = &server;
+  db.begin("https://project.supabase.co", "anon-key");
+  SupabaseHeap::begin(true);
+
+#ifdef SUPABASE_HEAP_WRAP_MALLOC
+  mallocHooks();
+#endif
+  steadyRequests();
+
+  printf(failures ? "%d FAILED\n" : "OK\n", failures);
+  return failures ? 1 : 0;
+}
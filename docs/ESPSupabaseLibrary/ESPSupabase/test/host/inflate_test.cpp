@@ -0,0 +1,202 @@
+// SupabaseInflateStream against zlib: gzip round trip at levels 0, 1, 6 and 9
+// for typical select responses and edge cases, with bytes on the wire and
+// decode time
+#include "SupabaseInflate.h"
+#include <zlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond)                                              \
+  do                                                             \
+  {                                                              \
+    if (!(cond))                                                 \
+    {                                                            \
+      printf("  FAIL %s:%d %s\n", __FILE__, __LINE__, #cond);    \
+      failures++;                                                \
+    }                                                            \
+  } while (0)
+
+// the response body, followed by what the connection carries next
+struct Body : Stream
+{
+  std::string data;
+  size_t pos = 0;
+  int available() override { return data.size() - pos; }
+  int read() override { return pos < data.size() ? (uint8_t)data[pos++] : -1; }
+  int peek() override { return pos < data.size() ? (uint8_t)data[pos] : -1; }
+  size_t write(uint8_t) override { return 0; }
+  size_t readBytes(char *buffer, size_t length) override
+  {
+    size_t n = std::min(length, data.size() - pos);
+    memcpy(buffer, data.data() + pos, n);
+    pos += n;
+    return n;
+  }
+};
+
+static std::string gzip(const std::string &raw, int level)
+{
+  z_stream z = {};
+  deflateInit2(&z, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&z, raw.size()), '\0');
+  z.next_in = (Bytef *)raw.data();
+  z.avail_in = raw.size();
+  z.next_out = (Bytef *)&out[0];
+  z.avail_out = out.size();
+  deflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return out;
+}
+
+// co_readings as the dashboard selects them
+static std::string coReadings(int rows)
+{
+  std::string s = "[";
+  char row[300];
+  for (int i = 0; i < rows; i++)
+  {
+    double level = 5 + (i * 37 % 400) / 10.0;
+    snprintf(row, sizeof(row), "%s{\"id\":%d,\"session_id\":\"8d5c0f2e-6a47-4c1e-9b1a-3f0e2d7c9a55\",\"device_id\":\"CO-SAFE-001\",\"co_level\":%.1f,\"status\":\"%s\",\"created_at\":\"2024-05-01T10:%02d:%02d.%03d+00:00\",\"mosfet_status\":%s}",
+             i ? "," : "", 120000 + i, level, level > 35 ? "critical" : level > 25 ? "warning" : "safe", i / 60 % 60, i % 60, i * 7 % 1000, level > 35 ? "true" : "false");
+    s += row;
+  }
+  return s + "]";
+}
+
+static std::string sessions(int rows)
+{
+  std::string s = "[";
+  char row[600];
+  for (int i = 0; i < rows; i++)
+  {
+    snprintf(row, sizeof(row), "%s{\"session_id\":\"%08x-6a47-4c1e-9b1a-3f0e2d7c%04x\",\"device_id\":\"CO-SAFE-%03d\",\"user_id\":\"1f0e2d7c-9a55-4c1e-8d5c-0f2e6a47%04x\",\"started_at\":\"2024-05-%02dT08:00:00+00:00\",\"ended_at\":\"2024-05-%02dT17:30:00+00:00\",\"notes\":\"Route %d, windows closed, AC on recirculation\",\"ai_analysis\":\"CO peaked at %d ppm during idling in traffic. Levels stayed in the safe range while moving. Recommend checking the exhaust seals.\",\"last_heartbeat\":\"2024-05-%02dT17:29:45+00:00\"}",
+             i ? "," : "", 0x8d5c0f2e + i, i, i % 7, i * 31, i % 28 + 1, i % 28 + 1, i % 12, 20 + i * 13 % 60, i % 28 + 1);
+    s += row;
+  }
+  return s + "]";
+}
+
+static std::string noise(size_t size, uint32_t seed = 1)
+{
+  std::string s(size, '\0');
+  uint32_t x = 2463534242u * seed;
+  for (auto &c : s)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    c = (char)x;
+  }
+  return s;
+}
+
+// matches reaching back across the whole 32 KB window
+static std::string farRepeats(size_t size)
+{
+  std::string block = noise(700);
+  std::string s;
+  for (size_t i = 0; s.size() < size; i++)
+  {
+    s += noise(30000 + i % 5 * 500, i + 2);
+    s += block;
+  }
+  return s.substr(0, size);
+}
+
+static bool inflate(const std::string &compressed, const std::string &raw, double *ns = nullptr)
+{
+  Body body;
+  body.data = compressed + "NEXT";
+  SupabaseInflateStream stream;
+  if (!stream.begin(body))
+  {
+    return false;
+  }
+  std::string out;
+  out.reserve(raw.size());
+  auto start = std::chrono::steady_clock::now();
+  int c;
+  while ((c = stream.read()) >= 0)
+  {
+    out += (char)c;
+  }
+  if (ns)
+  {
+    *ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  }
+  bool ok = out == raw && stream.finished() && !stream.failed() && stream.bytesRead() == raw.size() && body.data.substr(body.pos) == "NEXT";
+  stream.end();
+  return ok;
+}
+
+int main()
+{
+  struct Case
+  {
+    const char *name;
+    std::string raw;
+  } cases[] = {
+      {"co_readings 500 rows", coReadings(500)},
+      {"sessions 50 rows", sessions(50)},
+      {"empty", ""},
+      {"one byte", "["},
+      {"incompressible 70 KB", noise(70000)},
+      {"far repeats 200 KB", farRepeats(200000)},
+  };
+
+  printf("%-22s %8s %8s %8s %8s %8s %9s\n", "body", "raw", "level 0", "level 1", "level 6", "level 9", "MB/s (6)");
+  for (const Case &test : cases)
+  {
+    printf("%-22s %8zu", test.name, test.raw.size());
+    double rate = 0;
+    for (int level : {0, 1, 6, 9})
+    {
+      std::string compressed = gzip(test.raw, level);
+      double ns = 0;
+      bool ok = inflate(compressed, test.raw, &ns);
+      if (!ok)
+      {
+        printf("  FAIL %s at level %d\n", test.name, level);
+        failures++;
+      }
+      printf(" %8zu", compressed.size());
+      if (level == 6 && ns > 0)
+      {
+        rate = test.raw.size() / ns * 1000;
+      }
+    }
+    printf(" %9.1f\n", rate);
+  }
+
+  // a body cut short never reports finished
+  std::string raw = coReadings(100);
+  std::string cut = gzip(raw, 6);
+  cut.resize(cut.size() / 2);
+  Body body;
+  body.data = cut;
+  SupabaseInflateStream stream;
+  CHECK(stream.begin(body));
+  while (stream.read() >= 0)
+  {
+  }
+  CHECK(!stream.finished());
+  stream.end();
+
+  // not gzip at all
+  body.data = raw;
+  body.pos = 0;
+  CHECK(stream.begin(body));
+  CHECK(stream.read() < 0);
+  CHECK(stream.failed());
+  stream.end();
+
+  // the tables live on the heap, not on the caller's stack
+  printf("inflater object: %zu bytes\n", sizeof(SupabaseInflateStream));
+  CHECK(sizeof(SupabaseInflateStream) < 128);
+
+  printf(failures ? "%d FAILED\n" : "OK\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+#pragma once
+// Just enough of the Arduino core to build and run the library on a host
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string>
+#include <functional>
+#include <algorithm>
+typedef uint8_t byte;
+typedef bool boolean;
+#define PROGMEM
+#define PSTR(x) (x)
+#define F(x) (x)
+#define FPSTR(x) (x)
+#define HIGH 1
+#define LOW 0
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void yield();
+long random(long);
+long random(long, long);
+void randomSeed(unsigned long);
+class __FlashStringHelper;
+// Allocates like the Arduino core's WString: up to 11 characters inline,
+// longer ones in a malloc'd buffer that grows to exactly the length needed,
+// a + b copies a and then appends b
+class String {
+  enum { SSO = 12 };
+  char *ptr = nullptr; // heap buffer, nullptr while inline
+  char sso[SSO] = {};
+  unsigned cap = SSO - 1, len = 0;
+  char *buf() { return ptr ? ptr : sso; }
+  const char *buf() const { return ptr ? ptr : sso; }
+  void assign(const char *c, unsigned n) { if (!reserve(n)) return; memmove(buf(), c, n); len = n; buf()[n] = 0; }
+  void number(long long v) { char t[24]; assign(t, snprintf(t, sizeof(t), "%lld", v)); }
+  void unumber(unsigned long long v) { char t[24]; assign(t, snprintf(t, sizeof(t), "%llu", v)); }
+  static size_t find(const char *h, unsigned hn, const char *n, unsigned nn, unsigned from) {
+    if (nn > hn) return (size_t)-1;
+    for (unsigned i = from; i + nn <= hn; i++) if (memcmp(h + i, n, nn) == 0) return i;
+    return (size_t)-1;
+  }
+public:
+  String() {}
+  String(const char *c) { if (c) assign(c, strlen(c)); }
+  String(const std::string &x) { assign(x.data(), x.size()); }
+  String(const String &o) { assign(o.buf(), o.len); }
+  String(String &&o) { if (o.ptr) { ptr = o.ptr; cap = o.cap; len = o.len; o.ptr = nullptr; o.cap = SSO - 1; o.len = 0; o.sso[0] = 0; } else assign(o.sso, o.len); }
+  String(char c) { assign(&c, 1); }
+  String(int v, unsigned char base = 10) { number(v); }
+  String(unsigned int v, unsigned char base = 10) { unumber(v); }
+  String(long v, unsigned char base = 10) { number(v); }
+  String(unsigned long v, unsigned char base = 10) { unumber(v); }
+  String(long long v) { number(v); }
+  String(unsigned long long v) { unumber(v); }
+  String(double v, unsigned char d = 2) { char t[40]; assign(t, snprintf(t, sizeof(t), "%.*f", d, v)); }
+  String(float v, unsigned char d = 2) : String((double)v, d) {}
+  ~String() { free(ptr); }
+  String &operator=(const String &o) { if (this != &o) assign(o.buf(), o.len); return *this; }
+  String &operator=(String &&o) { if (this != &o) { if (o.ptr) { free(ptr); ptr = o.ptr; cap = o.cap; len = o.len; o.ptr = nullptr; o.cap = SSO - 1; o.len = 0; o.sso[0] = 0; } else assign(o.sso, o.len); } return *this; }
+  String &operator=(const char *c) { if (c) assign(c, strlen(c)); else assign("", 0); return *this; }
+  unsigned int length() const { return len; }
+  const char *c_str() const { return buf(); }
+  bool reserve(unsigned int n) {
+    if (n <= cap) return true;
+    char *p = (char *)(ptr ? realloc(ptr, n + 1) : malloc(n + 1));
+    if (!p) return false;
+    if (!ptr) memcpy(p, sso, len + 1);
+    ptr = p;
+    cap = n;
+    return true;
+  }
+  bool concat(const char *o, unsigned int n) { if (!reserve(len + n)) return false; memmove(buf() + len, o, n); len += n; buf()[len] = 0; return true; }
+  bool concat(const String &o) { return concat(o.buf(), o.len); }
+  bool concat(const char *o) { return o ? concat(o, strlen(o)) : false; }
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(int v) { return concat(String(v)); }
+  bool concat(unsigned int v) { return concat(String(v)); }
+  bool concat(long v) { return concat(String(v)); }
+  bool concat(unsigned long v) { return concat(String(v)); }
+  template <typename T> String &operator+=(const T &v) { concat(v); return *this; }
+  char operator[](unsigned int i) const { return i < len ? buf()[i] : 0; }
+  char &operator[](unsigned int i) { static char dummy; return i < len ? buf()[i] : (dummy = 0); }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+  int indexOf(char c, unsigned int from = 0) const { return indexOf(String(c), from); }
+  int indexOf(const String &c, unsigned int from = 0) const { size_t p = find(buf(), len, c.buf(), c.len, from); return p == (size_t)-1 ? -1 : (int)p; }
+  int lastIndexOf(char c) const { for (int i = (int)len - 1; i >= 0; i--) if (buf()[i] == c) return i; return -1; }
+  String substring(unsigned int a) const { return substring(a, len); }
+  String substring(unsigned int a, unsigned int b) const { if (b > len) b = len; if (a > b) std::swap(a, b); String r; r.concat(buf() + a, b - a); return r; }
+  long toInt() const { return atol(buf()); }
+  float toFloat() const { return atof(buf()); }
+  void trim() { unsigned a = 0, b = len; while (a < b && isspace((unsigned char)buf()[a])) a++; while (b > a && isspace((unsigned char)buf()[b - 1])) b--; memmove(buf(), buf() + a, b - a); len = b - a; buf()[len] = 0; }
+  void toLowerCase() { for (unsigned i = 0; i < len; i++) buf()[i] = tolower((unsigned char)buf()[i]); }
+  void replace(const String &a, const String &b) {
+    if (a.len == 0) return;
+    String r;
+    unsigned i = 0;
+    for (size_t p; (p = find(buf(), len, a.buf(), a.len, i)) != (size_t)-1; i = p + a.len) { r.concat(buf() + i, p - i); r.concat(b); }
+    r.concat(buf() + i, len - i);
+    *this = std::move(r);
+  }
+  void remove(unsigned int i) { remove(i, len); }
+  void remove(unsigned int i, unsigned int n) { if (i >= len) return; if (n > len - i) n = len - i; memmove(buf() + i, buf() + i + n, len - i - n); len -= n; buf()[len] = 0; }
+  bool startsWith(const String &p) const { return p.len <= len && memcmp(buf(), p.buf(), p.len) == 0; }
+  bool endsWith(const String &p) const { return p.len <= len && memcmp(buf() + len - p.len, p.buf(), p.len) == 0; }
+  bool equals(const String &o) const { return len == o.len && memcmp(buf(), o.buf(), len) == 0; }
+  bool equalsIgnoreCase(const String &o) const { return len == o.len && strncasecmp(buf(), o.buf(), len) == 0; }
+  bool isEmpty() const { return len == 0; }
+  void toCharArray(char *b, unsigned int n) const { getBytes((unsigned char *)b, n); }
+  void getBytes(unsigned char *b, unsigned int n) const { if (n) { size_t k = std::min<size_t>(n - 1, len); memcpy(b, buf(), k); b[k] = 0; } }
+  bool operator==(const String &o) const { return equals(o); }
+  bool operator==(const char *o) const { return strcmp(buf(), o) == 0; }
+  bool operator!=(const String &o) const { return !equals(o); }
+  bool operator!=(const char *o) const { return !(*this == o); }
+  bool operator<(const String &o) const { return strcmp(buf(), o.buf()) < 0; }
+  char *begin() { return buf(); }
+};
+// a + b copies a and appends b, a temporary on the left is appended to in place
+template <typename T> String operator+(const String &a, const T &b) { String r(a); r.concat(b); return r; }
+template <typename T> String operator+(String &&a, const T &b) { a.concat(b); return std::move(a); }
+inline String operator+(const char *a, const String &b) { String r(a); r.concat(b); return r; }
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *b, size_t n) { size_t i = 0; for (; i < n; i++) write(b[i]); return i; }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t write(const char *s, size_t n) { return write((const uint8_t *)s, n); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int = 10) { return print(String(v)); }
+  size_t print(unsigned int v, int = 10) { return print(String(v)); }
+  size_t print(long v, int = 10) { return print(String(v)); }
+  size_t print(unsigned long v, int = 10) { return print(String(v)); }
+  size_t print(double v, int = 2) { return print(String(v)); }
+  size_t println() { return write("\r\n"); }
+  size_t println(const String &s) { return print(s) + println(); }
+  size_t println(const char *s) { return print(s) + println(); }
+  size_t println(int v, int = 10) { return print(v) + println(); }
+  size_t println(unsigned int v, int = 10) { return print(v) + println(); }
+  size_t println(long v, int = 10) { return print(v) + println(); }
+  size_t println(unsigned long v, int = 10) { return print(v) + println(); }
+  size_t println(double v, int = 2) { return print(v) + println(); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    return n > 0 ? write(line, (size_t)n < sizeof(line) ? n : sizeof(line) - 1) : 0;
+  }
+};
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long) {}
+  unsigned long getTimeout() { return 0; }
+  bool find(const char *) { return false; }
+  bool find(char) { return false; }
+  bool findUntil(const char *, const char *) { return false; }
+  virtual size_t readBytes(char *b, size_t n) { size_t k = 0; int c; while (k < n && (c = read()) >= 0) b[k++] = c; return k; }
+  size_t readBytes(uint8_t *b, size_t n) { return readBytes((char *)b, n); }
+  size_t readBytesUntil(char, char *, size_t) { return 0; }
+  String readString() { String r; int c; while ((c = read()) >= 0) r += (char)c; return r; }
+  String readStringUntil(char t) { String r; int c; while ((c = read()) >= 0 && c != t) r += (char)c; return r; }
+  long parseInt() { return 0; }
+};
+// quiet unless verbose, the tests print their own results
+class HardwareSerial : public Stream {
+public:
+  bool verbose = false;
+  size_t write(uint8_t c) override { if (verbose) putchar(c); return 1; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void begin(unsigned long) {}
+};
+extern HardwareSerial Serial;
+class IPAddress { public: IPAddress() {} String toString() const { return String(); } operator uint32_t() const { return 0; } };
+struct EspClass {
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMaxFreeBlockSize() { return 0; }
+  uint8_t getHeapFragmentation() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+  uint32_t getMinFreeHeap() { return 0; }
+};
+extern EspClass ESP;
+uint32_t esp_random();
@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+#include <type_traits>
+class JsonVariant;
+class JsonPair;
+class JsonString { public: const char *c_str() const { return ""; } size_t size() const { return 0; } operator bool() const { return true; } bool operator==(const char*) const { return false; } };
+class JsonVariant {
+public:
+  JsonVariant() {}
+  template <typename K> JsonVariant operator[](const K &) const { return JsonVariant(); }
+  template <typename T> T as() const { return T(); }
+  template <typename T> bool is() const { return false; }
+  template <typename T, typename = typename std::enable_if<!std::is_class<T>::value || std::is_same<T, String>::value>::type> operator T() const { return T(); }
+  template <typename T> JsonVariant &operator=(const T &) { return *this; }
+  template <typename T> bool set(const T &) { return true; }
+  template <typename T> bool operator==(const T &) const { return false; }
+  template <typename T> bool operator!=(const T &) const { return true; }
+  template <typename K> bool containsKey(const K &) const { return false; }
+  bool isNull() const { return true; }
+  template <typename T = JsonVariant> T add() { return T(); }
+  template <typename T> bool add(const T &) { return true; }
+  size_t size() const { return 0; }
+  template <typename K> void remove(const K &) {}
+  void clear() {}
+  JsonVariant *begin() const { return nullptr; }
+  JsonVariant *end() const { return nullptr; }
+  template <typename T> T to() { return T(); }
+  bool isUnbound() const { return false; }
+};
+template <typename T> T operator|(const JsonVariant &, T d) { return d; }
+inline const char *operator|(const JsonVariant &, const char *d) { return d; }
+inline const char *serialized(const String &s) { return s.c_str(); }
+typedef JsonVariant JsonVariantConst;
+typedef JsonVariant JsonObject;
+typedef JsonVariant JsonObjectConst;
+typedef JsonVariant JsonArray;
+typedef JsonVariant JsonArrayConst;
+class JsonDocument : public JsonVariant {
+public:
+  JsonDocument() {}
+  using JsonVariant::operator=;
+  bool overflowed() const { return false; }
+  JsonVariant as_variant() { return *this; }
+  void shrinkToFit() {}
+};
+class DeserializationError {
+public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+  DeserializationError() {}
+  DeserializationError(Code) {}
+  Code code() const { return Ok; }
+  const char *c_str() const { return ""; }
+  explicit operator bool() const { return false; }
+  bool operator==(Code) const { return false; }
+  bool operator!=(Code) const { return true; }
+};
+namespace DeserializationOption {
+struct Filter { Filter(JsonVariant) {} };
+struct NestingLimit { NestingLimit(int) {} };
+}
+template <typename I> DeserializationError deserializeJson(JsonDocument &, I &&) { return {}; }
+template <typename I> DeserializationError deserializeJson(JsonDocument &, I &&, size_t) { return {}; }
+template <typename I, typename O> DeserializationError deserializeJson(JsonDocument &, I &&, O) { return {}; }
+template <typename I, typename O, typename P> DeserializationError deserializeJson(JsonDocument &, I &&, O, P) { return {}; }
+inline DeserializationError deserializeJson(JsonDocument &, const char *, size_t, DeserializationOption::Filter) { return {}; }
+template <typename O> size_t serializeJson(const JsonVariant &, O &&) { return 0; }
+inline size_t serializeJson(const JsonVariant &, char *, size_t) { return 0; }
+inline size_t measureJson(const JsonVariant &) { return 0; }
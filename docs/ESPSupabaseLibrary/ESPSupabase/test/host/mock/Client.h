@@ -0,0 +1,17 @@
+#pragma once
+#include <Arduino.h>
+class Client : public Stream {
+public:
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual int connect(IPAddress, uint16_t) { return 0; }
+  using Print::write;
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t n) override { return n; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  virtual int read(uint8_t *, size_t) { return 0; }
+  int peek() override { return -1; }
+  virtual void stop() {}
+  virtual uint8_t connected() { return 0; }
+  operator bool() { return true; }
+};
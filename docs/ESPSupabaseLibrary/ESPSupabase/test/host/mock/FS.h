@@ -0,0 +1,46 @@
+#pragma once
+// In-memory file system, files live as long as the FS
+#include <Arduino.h>
+#include <map>
+#include <memory>
+namespace fs {
+enum SeekMode { SeekSet, SeekCur, SeekEnd };
+class File : public Stream {
+  std::shared_ptr<std::string> data;
+  size_t pos = 0;
+public:
+  File() {}
+  File(std::shared_ptr<std::string> d) : data(d) {}
+  int available() override { return data ? data->size() - pos : 0; }
+  int read() override { return data && pos < data->size() ? (uint8_t)(*data)[pos++] : -1; }
+  int peek() override { return data && pos < data->size() ? (uint8_t)(*data)[pos] : -1; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *b, size_t n) override { if (!data) return 0; data->replace(pos, std::min(n, data->size() - pos), (const char *)b, n); pos += n; return n; }
+  using Print::write;
+  bool seek(uint32_t p, SeekMode mode) { size_t to = mode == SeekSet ? p : mode == SeekCur ? pos + p : size() + p; if (!data || to > data->size()) return false; pos = to; return true; }
+  bool seek(uint32_t p) { return seek(p, SeekSet); }
+  size_t position() const { return pos; }
+  size_t size() const { return data ? data->size() : 0; }
+  void close() { data.reset(); }
+  operator bool() const { return (bool)data; }
+};
+class FS {
+  std::map<std::string, std::shared_ptr<std::string>> files;
+public:
+  File open(const char *path, const char *mode = "r") {
+    auto f = files.find(path);
+    if (mode[0] == 'w' || (mode[0] == 'a' && f == files.end())) return File(files[path] = std::make_shared<std::string>());
+    if (f == files.end()) return File();
+    File file(f->second);
+    if (mode[0] == 'a') file.seek(0, SeekEnd);
+    return file;
+  }
+  File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+  bool exists(const char *path) { return files.count(path) > 0; }
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path) { return files.erase(path) > 0; }
+  bool remove(const String &path) { return remove(path.c_str()); }
+};
+}
+using fs::FS;
+using fs::File;
@@ -0,0 +1,137 @@
+#pragma once
+#include <WiFiClientSecure.h>
+#include <strings.h>
+#include <vector>
+#define HTTPCLIENT_DEFAULT_TCP_TIMEOUT (5000)
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+// Talks HTTP/1.1 over the WiFiClient it is given, so requests reach the
+// MockServer. Builds the request and reads the response head with Strings the
+// way the ESP32 core's HTTPClient does, its allocations are roughly those.
+class HTTPClient {
+  WiFiClient *client = nullptr;
+  String host, uri, headers;
+  bool reuse = true, canReuse = false, chunked = false;
+  long size = -1;
+  const char *const *keys = nullptr;
+  size_t keyCount = 0;
+  std::vector<String> values;
+
+  int readHead() {
+    int code = 0;
+    size = -1;
+    chunked = false;
+    canReuse = reuse;
+    values.assign(keyCount, String());
+    while (true) {
+      if (!client->connected() && client->available() == 0) return HTTPC_ERROR_CONNECTION_LOST;
+      if (client->available() == 0) return HTTPC_ERROR_READ_TIMEOUT;
+      String line = client->readStringUntil('\n');
+      line.trim();
+      if (code == 0) {
+        if (!line.startsWith("HTTP/1.")) return HTTPC_ERROR_NO_HTTP_SERVER;
+        code = line.substring(9, 12).toInt();
+        continue;
+      }
+      if (line.length() == 0) return code;
+      int colon = line.indexOf(':');
+      if (colon < 0) continue;
+      String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      value.trim();
+      if (name.equalsIgnoreCase("Content-Length")) size = value.toInt();
+      if (name.equalsIgnoreCase("Connection") && value.equalsIgnoreCase("close")) canReuse = false;
+      if (name.equalsIgnoreCase("Transfer-Encoding") && value.equalsIgnoreCase("chunked")) chunked = true;
+      for (size_t i = 0; i < keyCount; i++)
+        if (name.equalsIgnoreCase(keys[i])) values[i] = value;
+    }
+  }
+
+  // the body as it is on the wire, without chunk framing
+  template <typename Sink> int body(Sink sink) {
+    int total = 0;
+    if (chunked) {
+      while (true) {
+        String line = client->readStringUntil('\n');
+        long n = strtol(line.c_str(), nullptr, 16);
+        if (n <= 0) { client->readStringUntil('\n'); break; }
+        for (long i = 0; i < n; i++) { int c = client->read(); if (c < 0) return total; sink((char)c); total++; }
+        client->readStringUntil('\n');
+      }
+    } else {
+      for (long i = 0; size < 0 || i < size; i++) { int c = client->read(); if (c < 0) break; sink((char)c); total++; }
+    }
+    size = 0;
+    return total;
+  }
+
+public:
+  bool begin(WiFiClient &c, const String &url) {
+    client = &c;
+    int start = url.indexOf("//");
+    start = start < 0 ? 0 : start + 2;
+    int slash = url.indexOf('/', start);
+    host = url.substring(start, slash < 0 ? url.length() : slash);
+    uri = slash < 0 ? String("/") : url.substring(slash);
+    headers = "";
+    size = -1;
+    return true;
+  }
+  void end() {
+    if (client && !(reuse && canReuse && client->connected())) client->stop();
+    headers = "";
+  }
+  bool connected() { return client && client->connected(); }
+  void setReuse(bool r) { reuse = r; }
+  void setTimeout(uint16_t) {}
+  void setConnectTimeout(int32_t) {}
+  void useHTTP10(bool = true) {}
+  void addHeader(const String &name, const String &value, bool = false, bool = true) { headers += name + ": " + value + "\r\n"; }
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) { keys = headerKeys; keyCount = headerKeysCount; }
+  String header(const char *name) {
+    for (size_t i = 0; i < keyCount && i < values.size(); i++)
+      if (!strcasecmp(keys[i], name)) return values[i];
+    return String();
+  }
+  bool hasHeader(const char *name) { return header(name).length() > 0; }
+  int GET() { return sendRequest("GET"); }
+  int POST(const String &payload) { return sendRequest("POST", payload); }
+  int POST(const uint8_t *payload, size_t n) { return sendRequest("POST", payload, n); }
+  int PATCH(const String &payload) { return sendRequest("PATCH", payload); }
+  int PATCH(const uint8_t *payload, size_t n) { return sendRequest("PATCH", payload, n); }
+  int sendRequest(const char *method, const String &payload) { return sendRequest(method, (const uint8_t *)payload.c_str(), payload.length()); }
+  int sendRequest(const char *method, const uint8_t *payload = NULL, size_t n = 0) {
+    if (!client) return HTTPC_ERROR_NOT_CONNECTED;
+    if (!client->connected() && !client->connect(host.c_str(), 443)) return HTTPC_ERROR_CONNECTION_REFUSED;
+    if (payload && n > 0) addHeader("Content-Length", String((unsigned)n));
+    String head = String(method) + " " + uri + " HTTP/1.1\r\nHost: " + host + "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: " + (reuse ? "keep-alive" : "close") + "\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n" + headers + "\r\n";
+    if (client->write((const uint8_t *)head.c_str(), head.length()) != head.length()) return HTTPC_ERROR_SEND_HEADER_FAILED;
+    if (payload && n > 0 && client->write(payload, n) != n) return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    return readHead();
+  }
+  int sendRequest(const char *method, Stream *stream, size_t n) {
+    String payload;
+    for (size_t i = 0; i < n; i++) { int c = stream->read(); if (c < 0) break; payload += (char)c; }
+    return sendRequest(method, payload);
+  }
+  int getSize() { return size; }
+  String getString() {
+    String out;
+    if (size > 0) out.reserve(size);
+    body([&out](char c) { out += c; });
+    return out;
+  }
+  WiFiClient &getStream() { return *client; }
+  WiFiClient *getStreamPtr() { return client; }
+  int writeToStream(Stream *stream) { return body([stream](char c) { stream->write((uint8_t)c); }); }
+  static String errorToString(int) { return String(); }
+};
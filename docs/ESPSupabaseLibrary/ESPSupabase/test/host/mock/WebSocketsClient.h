@@ -0,0 +1,34 @@
+#pragma once
+// Keeps the event handler and what was sent, so a test can play the server:
+// WebSocketsClient::last->receive(WStype_TEXT, frame)
+#include <Arduino.h>
+#include <string>
+#include <vector>
+typedef enum { WStype_ERROR, WStype_DISCONNECTED, WStype_CONNECTED, WStype_TEXT, WStype_BIN, WStype_FRAGMENT_TEXT_START, WStype_FRAGMENT_BIN_START, WStype_FRAGMENT, WStype_FRAGMENT_FIN, WStype_PING, WStype_PONG } WStype_t;
+class WebSocketsClient {
+public:
+  typedef std::function<void(WStype_t type, uint8_t *payload, size_t length)> WebSocketClientEvent;
+  static inline WebSocketsClient *last = nullptr;
+  WebSocketClientEvent event;
+  std::vector<std::string> sent;
+  bool up = false;
+  void beginSSL(const char *, uint16_t, const char * = "/", const char * = "", const char * = "arduino") { last = this; }
+  void beginSSL(const String &, uint16_t, const String & = "/", const String & = "", const String & = "arduino") { last = this; }
+  void onEvent(WebSocketClientEvent e) { event = e; }
+  bool sendTXT(const char *s) { sent.push_back(s); return up; }
+  bool sendTXT(String &s) { return sendTXT(s.c_str()); }
+  bool sendTXT(uint8_t *s, size_t n = 0, bool = false) { sent.push_back(std::string((const char *)s, n)); return up; }
+  bool sendTXT(const uint8_t *s, size_t n = 0) { sent.push_back(std::string((const char *)s, n)); return up; }
+  void loop() {}
+  void disconnect() { if (up) receive(WStype_DISCONNECTED, ""); }
+  bool isConnected() { return up; }
+  void setReconnectInterval(unsigned long) {}
+  void enableHeartbeat(uint32_t, uint32_t, uint8_t) {}
+  void setExtraHeaders(const char * = NULL) {}
+  void receive(WStype_t type, const std::string &payload) {
+    up = type != WStype_DISCONNECTED && (up || type == WStype_CONNECTED);
+    std::vector<uint8_t> frame(payload.begin(), payload.end());
+    frame.push_back(0);
+    if (event) event(type, frame.data(), payload.size());
+  }
+};
@@ -0,0 +1,5 @@
+#pragma once
+#include <WiFiClientSecure.h>
+#define WL_CONNECTED 3
+struct WiFiClass { int status() { return 0; } int hostByName(const char *, IPAddress &) { return 1; } int hostByName(const char *, IPAddress &, uint32_t) { return 1; } };
+extern WiFiClass WiFi;
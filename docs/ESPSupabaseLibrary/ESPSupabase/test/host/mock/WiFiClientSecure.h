@@ -0,0 +1,98 @@
+#pragma once
+// A WiFiClient that talks to a MockServer in the same process. Every complete
+// request (headers and Content-Length bytes of body) goes to handle(), what it
+// returns is the response the client reads.
+#include <Client.h>
+#include <string>
+
+struct MockServer {
+  virtual ~MockServer() {}
+  virtual std::string handle(const std::string &head, const std::string &body) = 0;
+  // the connection broke after part of body was received
+  virtual void interrupted(const std::string &head, const std::string &body) {}
+  long breakAfter = -1; // bytes the connection still carries before it breaks, -1 for no limit
+  bool refuse = false;  // connect() fails
+  // the server closes the kept-alive connection before request number staleAt
+  // (counting from 1) if it comes on a reused one. The client only notices
+  // when it writes: the write fails with staleReset, otherwise it is taken and
+  // never answered
+  unsigned staleAt = 0;
+  bool staleReset = false;
+  unsigned connects = 0, requests = 0;
+  size_t bytesIn = 0, bytesOut = 0; // request and response bytes on the wire
+};
+extern MockServer *mockServer;
+
+class WiFiClient : public Client {
+  bool up = false;
+  bool silent = false; // closed by the server, writes go nowhere
+  unsigned served = 0; // requests answered on this connection
+  std::string in, out;
+  void broken() {
+    size_t e = in.find("\r\n\r\n");
+    if (e != std::string::npos) mockServer->interrupted(in.substr(0, e), in.substr(e + 4));
+    up = false;
+    in.clear();
+  }
+public:
+  int connect(const char *, uint16_t) override {
+    stop();
+    if (!mockServer || mockServer->refuse) return 0;
+    mockServer->connects++;
+    up = true;
+    served = 0;
+    return 1;
+  }
+  int connect(IPAddress, uint16_t) override { return connect("", 443); }
+  void setNoDelay(bool) {}
+  void setTimeout(unsigned long) {}
+  int availableForWrite() override { return up ? 1460 : 0; }
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *b, size_t n) override {
+    if (up && served > 0 && in.empty() && mockServer->staleAt == mockServer->requests + 1) {
+      mockServer->staleAt = 0;
+      if (mockServer->staleReset) { up = false; return 0; }
+      silent = true;
+    }
+    if (!up) return 0;
+    if (silent) return n;
+    size_t k = n;
+    if (mockServer->breakAfter >= 0 && (long)n > mockServer->breakAfter) k = mockServer->breakAfter;
+    if (mockServer->breakAfter >= 0) mockServer->breakAfter -= k;
+    in.append((const char *)b, k);
+    mockServer->bytesIn += k;
+    size_t e;
+    while ((e = in.find("\r\n\r\n")) != std::string::npos) {
+      std::string head = in.substr(0, e);
+      size_t cl = head.find("Content-Length: ");
+      size_t length = cl == std::string::npos ? 0 : strtoul(head.c_str() + cl + 16, nullptr, 10);
+      if (in.size() < e + 4 + length) break;
+      mockServer->requests++;
+      served++;
+      std::string response = mockServer->handle(head, in.substr(e + 4, length));
+      mockServer->bytesOut += response.size();
+      out += response;
+      in.erase(0, e + 4 + length);
+    }
+    if (k < n) { mockServer->breakAfter = -1; broken(); }
+    return k;
+  }
+  int available() override { return out.size(); }
+  int read() override { if (out.empty()) return -1; int c = (uint8_t)out[0]; out.erase(0, 1); return c; }
+  int read(uint8_t *b, size_t n) override { size_t k = std::min(n, out.size()); memcpy(b, out.data(), k); out.erase(0, k); return k; }
+  int peek() override { return out.empty() ? -1 : (uint8_t)out[0]; }
+  void stop() override { up = false; silent = false; in.clear(); out.clear(); }
+  uint8_t connected() override { return (up && !silent) || !out.empty(); }
+};
+
+class WiFiClientSecure : public WiFiClient {
+public:
+  using WiFiClient::connect;
+  // the ESP32 core's connect to a resolved address that keeps SNI
+  int connect(IPAddress ip, uint16_t port, const char *, const char *, const char *, const char *) { return WiFiClient::connect(ip, port); }
+  void setInsecure() {}
+  void setBufferSizes(int, int) {}
+  void setHandshakeTimeout(unsigned long) {}
+  void setSession(void *) {}
+};
@@ -0,0 +1,503 @@
+#pragma once
+// A small working stand-in for ArduinoJson 7, enough for the realtime code:
+// documents, member and element access that creates on assignment, filters,
+// parsing and serializing. Values are nodes allocated with new, so heap
+// counts measured with it are not those of ArduinoJson's pool.
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mockjson {
+struct Node {
+  enum Type : uint8_t { NUL, BOOL, INT, FLOAT, STR, RAW, ARR, OBJ } type = NUL;
+  bool b = false;
+  long long i = 0;
+  double f = 0;
+  std::string s;
+  std::vector<std::pair<std::string, Node *>> items; // keys are empty in arrays
+  Node() {}
+  Node(const Node &o) { copy(o); }
+  Node &operator=(const Node &o) { if (this != &o) copy(o); return *this; }
+  ~Node() { clear(); }
+  void clear() {
+    for (auto &it : items) delete it.second;
+    items.clear();
+    s.clear();
+    type = NUL;
+  }
+  void copy(const Node &o) {
+    // o may be inside this node
+    Node tmp;
+    tmp.type = o.type; tmp.b = o.b; tmp.i = o.i; tmp.f = o.f; tmp.s = o.s;
+    for (auto &it : o.items) tmp.items.push_back({it.first, new Node(*it.second)});
+    clear();
+    type = tmp.type; b = tmp.b; i = tmp.i; f = tmp.f; s.swap(tmp.s); items.swap(tmp.items);
+  }
+  Node *member(const char *key) const {
+    if (type != OBJ) return nullptr;
+    for (auto &it : items) if (it.first == key) return it.second;
+    return nullptr;
+  }
+  Node *element(size_t index) const {
+    return type == ARR && index < items.size() ? items[index].second : nullptr;
+  }
+};
+}
+
+struct RawJson { std::string json; };
+inline RawJson serialized(const String &s) { return {s.c_str()}; }
+inline RawJson serialized(const char *s) { return {s}; }
+
+class JsonObject;
+class JsonArray;
+class JsonDocument;
+
+class JsonVariant {
+protected:
+  mutable mockjson::Node *node = nullptr;
+  // where an unbound member or element gets created on assignment
+  std::shared_ptr<JsonVariant> parent;
+  std::string key;
+  long index = -1;
+
+  mockjson::Node *resolve(bool create) const {
+    if (node || !create || !parent) return node;
+    mockjson::Node *p = parent->resolve(true);
+    if (!p) return nullptr;
+    if (index >= 0) {
+      if (p->type != mockjson::Node::ARR) { p->clear(); p->type = mockjson::Node::ARR; }
+      while ((long)p->items.size() <= index) p->items.push_back({"", new mockjson::Node});
+      node = p->items[index].second;
+    } else {
+      if (p->type != mockjson::Node::OBJ) { p->clear(); p->type = mockjson::Node::OBJ; }
+      node = p->member(key.c_str());
+      if (!node) { node = new mockjson::Node; p->items.push_back({key, node}); }
+    }
+    return node;
+  }
+
+  template <typename T> void setValue(const T &v) {
+    mockjson::Node *n = resolve(true);
+    if (!n) return;
+    n->clear();
+    assign(*n, v);
+  }
+  static void assign(mockjson::Node &n, const char *v) { if (v) { n.type = mockjson::Node::STR; n.s = v; } }
+  static void assign(mockjson::Node &n, char *v) { assign(n, (const char *)v); }
+  static void assign(mockjson::Node &n, const String &v) { n.type = mockjson::Node::STR; n.s = v.c_str(); }
+  static void assign(mockjson::Node &n, const std::string &v) { n.type = mockjson::Node::STR; n.s = v; }
+  static void assign(mockjson::Node &n, const RawJson &v) { n.type = mockjson::Node::RAW; n.s = v.json; }
+  static void assign(mockjson::Node &n, bool v) { n.type = mockjson::Node::BOOL; n.b = v; }
+  static void assign(mockjson::Node &n, float v) { n.type = mockjson::Node::FLOAT; n.f = v; }
+  static void assign(mockjson::Node &n, double v) { n.type = mockjson::Node::FLOAT; n.f = v; }
+  template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+  static void assign(mockjson::Node &n, T v) { n.type = mockjson::Node::INT; n.i = (long long)v; }
+  static void assign(mockjson::Node &n, const JsonVariant &v) {
+    mockjson::Node *src = v.resolve(false);
+    if (src) n.copy(*src);
+  }
+
+  template <typename T> struct Is { static bool test(const mockjson::Node *n) { return n && (n->type == mockjson::Node::INT || n->type == mockjson::Node::FLOAT); } };
+
+public:
+  JsonVariant() {}
+  explicit JsonVariant(mockjson::Node *n) : node(n) {}
+  JsonVariant(const JsonVariant &) = default;
+  // assigning to a variable rebinds it, assigning to a member copies the value
+  JsonVariant &operator=(const JsonVariant &v) & = default;
+  JsonVariant &operator=(const JsonVariant &v) && { setValue(v); return *this; }
+  template <typename T, typename = typename std::enable_if<!std::is_base_of<JsonVariant, T>::value>::type>
+  JsonVariant &operator=(const T &v) { setValue(v); return *this; }
+  template <typename T> bool set(const T &v) { setValue(v); return true; }
+
+  JsonVariant operator[](const char *k) const {
+    mockjson::Node *n = resolve(false);
+    mockjson::Node *m = n ? n->member(k) : nullptr;
+    if (m) return JsonVariant(m);
+    JsonVariant v;
+    v.parent = std::make_shared<JsonVariant>(*this);
+    v.key = k;
+    return v;
+  }
+  JsonVariant operator[](const String &k) const { return (*this)[k.c_str()]; }
+  template <typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+  JsonVariant operator[](I i) const {
+    mockjson::Node *n = resolve(false);
+    mockjson::Node *e = n ? n->element((size_t)i) : nullptr;
+    if (e) return JsonVariant(e);
+    JsonVariant v;
+    v.parent = std::make_shared<JsonVariant>(*this);
+    v.index = (long)i;
+    return v;
+  }
+
+  template <typename T> T as() const;
+  template <typename T> bool is() const { return Is<T>::test(resolve(false)); }
+  template <typename T, typename = typename std::enable_if<!std::is_base_of<JsonVariant, T>::value && (!std::is_class<T>::value || std::is_same<T, String>::value)>::type>
+  operator T() const { return as<T>(); }
+
+  bool isNull() const { mockjson::Node *n = resolve(false); return !n || n->type == mockjson::Node::NUL; }
+  bool isUnbound() const { return !resolve(false); }
+  size_t size() const {
+    mockjson::Node *n = resolve(false);
+    return n && (n->type == mockjson::Node::ARR || n->type == mockjson::Node::OBJ) ? n->items.size() : 0;
+  }
+  bool containsKey(const char *k) const { mockjson::Node *n = resolve(false); return n && n->member(k); }
+  bool containsKey(const String &k) const { return containsKey(k.c_str()); }
+  void remove(const char *k) {
+    mockjson::Node *n = resolve(false);
+    if (!n) return;
+    for (auto it = n->items.begin(); it != n->items.end(); ++it)
+      if (it->first == k) { delete it->second; n->items.erase(it); return; }
+  }
+  void clear() { mockjson::Node *n = resolve(false); if (n) n->clear(); }
+
+  template <typename T> T to();
+  template <typename T = JsonVariant> T add();
+  template <typename T> bool add(const T &v) {
+    mockjson::Node *n = resolve(true);
+    if (!n) return false;
+    if (n->type != mockjson::Node::ARR) { n->clear(); n->type = mockjson::Node::ARR; }
+    mockjson::Node *e = new mockjson::Node;
+    n->items.push_back({"", e});
+    assign(*e, v);
+    return true;
+  }
+
+  class iterator {
+    const std::vector<std::pair<std::string, mockjson::Node *>> *items;
+    size_t at;
+  public:
+    iterator(const std::vector<std::pair<std::string, mockjson::Node *>> *i, size_t a) : items(i), at(a) {}
+    JsonVariant operator*() const { return JsonVariant((*items)[at].second); }
+    iterator &operator++() { at++; return *this; }
+    bool operator!=(const iterator &o) const { return at != o.at; }
+  };
+  iterator begin() const { mockjson::Node *n = resolve(false); return n ? iterator(&n->items, 0) : iterator(nullptr, 0); }
+  iterator end() const { mockjson::Node *n = resolve(false); return n ? iterator(&n->items, n->items.size()) : iterator(nullptr, 0); }
+
+  const mockjson::Node *_node() const { return resolve(false); }
+};
+
+class JsonObject : public JsonVariant {
+public:
+  JsonObject() {}
+  JsonObject(const JsonVariant &v) : JsonVariant(v) {}
+  using JsonVariant::operator=;
+  JsonObject &operator=(const JsonObject &v) & = default;
+};
+class JsonArray : public JsonVariant {
+public:
+  JsonArray() {}
+  JsonArray(const JsonVariant &v) : JsonVariant(v) {}
+  using JsonVariant::operator=;
+  JsonArray &operator=(const JsonArray &v) & = default;
+};
+typedef JsonVariant JsonVariantConst;
+typedef JsonObject JsonObjectConst;
+typedef JsonArray JsonArrayConst;
+
+template <> struct JsonVariant::Is<const char *> { static bool test(const mockjson::Node *n) { return n && n->type == mockjson::Node::STR; } };
+template <> struct JsonVariant::Is<String> { static bool test(const mockjson::Node *n) { return n && n->type == mockjson::Node::STR; } };
+template <> struct JsonVariant::Is<bool> { static bool test(const mockjson::Node *n) { return n && n->type == mockjson::Node::BOOL; } };
+template <> struct JsonVariant::Is<JsonObject> { static bool test(const mockjson::Node *n) { return n && n->type == mockjson::Node::OBJ; } };
+template <> struct JsonVariant::Is<JsonArray> { static bool test(const mockjson::Node *n) { return n && n->type == mockjson::Node::ARR; } };
+template <> struct JsonVariant::Is<JsonVariant> { static bool test(const mockjson::Node *n) { return n != nullptr; } };
+
+namespace mockjson {
+template <typename T, typename Enable = void> struct As {
+  static T get(const Node *n) {
+    if (!n) return T();
+    if (n->type == Node::INT) return (T)n->i;
+    if (n->type == Node::FLOAT) return (T)n->f;
+    if (n->type == Node::BOOL) return (T)n->b;
+    return T();
+  }
+};
+template <> struct As<const char *> { static const char *get(const Node *n) { return n && n->type == Node::STR ? n->s.c_str() : nullptr; } };
+template <> struct As<String> { static String get(const Node *n) { return n && n->type == Node::STR ? String(n->s.c_str()) : String(); } };
+template <typename T> struct As<T, typename std::enable_if<std::is_base_of<JsonVariant, T>::value>::type> {
+  static T get(const Node *n) { return T(JsonVariant(const_cast<Node *>(n))); }
+};
+}
+
+template <typename T> T JsonVariant::as() const { return mockjson::As<T>::get(resolve(false)); }
+
+template <typename T> T JsonVariant::to() {
+  mockjson::Node *n = resolve(true);
+  if (n) {
+    n->clear();
+    if (std::is_same<T, JsonObject>::value) n->type = mockjson::Node::OBJ;
+    if (std::is_same<T, JsonArray>::value) n->type = mockjson::Node::ARR;
+  }
+  return T(JsonVariant(n));
+}
+
+template <typename T> T JsonVariant::add() {
+  mockjson::Node *n = resolve(true);
+  if (!n) return T();
+  if (n->type != mockjson::Node::ARR) { n->clear(); n->type = mockjson::Node::ARR; }
+  mockjson::Node *e = new mockjson::Node;
+  if (std::is_same<T, JsonObject>::value) e->type = mockjson::Node::OBJ;
+  if (std::is_same<T, JsonArray>::value) e->type = mockjson::Node::ARR;
+  n->items.push_back({"", e});
+  return T(JsonVariant(e));
+}
+
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+T operator|(const JsonVariant &v, T d) { return v.is<T>() || (std::is_arithmetic<T>::value && v.is<long>()) ? v.as<T>() : d; }
+inline const char *operator|(const JsonVariant &v, const char *d) { const char *s = v.as<const char *>(); return s ? s : d; }
+inline String operator|(const JsonVariant &v, const String &d) { return v.is<String>() ? v.as<String>() : d; }
+
+class JsonDocument : public JsonVariant {
+  std::unique_ptr<mockjson::Node> root;
+public:
+  JsonDocument() : root(new mockjson::Node) { node = root.get(); }
+  JsonDocument(const JsonDocument &o) : root(new mockjson::Node(*o.root)) { node = root.get(); }
+  JsonDocument &operator=(const JsonDocument &o) { root->copy(*o.root); return *this; }
+  template <typename T, typename = typename std::enable_if<!std::is_same<T, JsonDocument>::value>::type>
+  JsonDocument &operator=(const T &v) { set(v); return *this; }
+  bool overflowed() const { return false; }
+  void shrinkToFit() {}
+  void clear() { root->clear(); }
+  mockjson::Node &_root() { return *root; }
+};
+
+class DeserializationError {
+public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+  DeserializationError(Code c = Ok) : value(c) {}
+  Code code() const { return value; }
+  const char *c_str() const {
+    static const char *names[] = {"Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "NoMemory", "TooDeep"};
+    return names[value];
+  }
+  explicit operator bool() const { return value != Ok; }
+  bool operator==(Code c) const { return value == c; }
+  bool operator!=(Code c) const { return value != c; }
+private:
+  Code value;
+};
+
+namespace DeserializationOption {
+struct Filter {
+  const mockjson::Node *node;
+  Filter(const JsonVariant &v) : node(v._node()) {}
+};
+struct NestingLimit { NestingLimit(int) {} };
+}
+
+namespace mockjson {
+struct Parser {
+  const char *p, *end;
+  int depth = 0;
+  DeserializationError::Code error = DeserializationError::Ok;
+
+  void space() { while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++; }
+  bool fail(DeserializationError::Code c) { if (error == DeserializationError::Ok) error = c; return false; }
+
+  bool string(std::string *out) {
+    p++; // opening quote
+    while (p < end && *p != '"') {
+      char c = *p++;
+      if (c == '\\') {
+        if (p >= end) return fail(DeserializationError::IncompleteInput);
+        char e = *p++;
+        switch (e) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u': {
+          if (end - p < 4) return fail(DeserializationError::IncompleteInput);
+          unsigned code = strtoul(std::string(p, 4).c_str(), nullptr, 16);
+          p += 4;
+          if (out) {
+            if (code < 0x80) *out += (char)code;
+            else if (code < 0x800) { *out += (char)(0xc0 | (code >> 6)); *out += (char)(0x80 | (code & 0x3f)); }
+            else { *out += (char)(0xe0 | (code >> 12)); *out += (char)(0x80 | ((code >> 6) & 0x3f)); *out += (char)(0x80 | (code & 0x3f)); }
+          }
+          continue;
+        }
+        default: c = e;
+        }
+      }
+      if (out) *out += c;
+    }
+    if (p >= end) return fail(DeserializationError::IncompleteInput);
+    p++;
+    return true;
+  }
+
+  // out is null when the value is filtered out, filter null keeps everything
+  bool value(Node *out, const Node *filter) {
+    space();
+    if (p >= end) return fail(DeserializationError::IncompleteInput);
+    bool keepAll = !filter || (filter->type == Node::BOOL && filter->b);
+    char c = *p;
+    if (c == '{') {
+      if (++depth > 10) return fail(DeserializationError::TooDeep);
+      bool keep = out && (keepAll || filter->type == Node::OBJ);
+      if (keep) out->type = Node::OBJ;
+      p++;
+      space();
+      if (p < end && *p == '}') { p++; depth--; return true; }
+      while (true) {
+        space();
+        if (p >= end) return fail(DeserializationError::IncompleteInput);
+        if (*p != '"') return fail(DeserializationError::InvalidInput);
+        std::string k;
+        if (!string(&k)) return false;
+        space();
+        if (p >= end || *p != ':') return fail(p >= end ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput);
+        p++;
+        const Node *sub = keepAll ? nullptr : (keep ? filter->member(k.c_str()) : nullptr);
+        Node *child = nullptr;
+        if (keep && (keepAll || sub)) {
+          child = new Node;
+          out->items.push_back({k, child});
+        }
+        if (!value(child, keepAll ? nullptr : sub)) return false;
+        space();
+        if (p >= end) return fail(DeserializationError::IncompleteInput);
+        if (*p == ',') { p++; continue; }
+        if (*p == '}') { p++; depth--; return true; }
+        return fail(DeserializationError::InvalidInput);
+      }
+    }
+    if (c == '[') {
+      if (++depth > 10) return fail(DeserializationError::TooDeep);
+      bool keep = out && (keepAll || filter->type == Node::ARR);
+      const Node *sub = keepAll ? nullptr : (keep ? filter->element(0) : nullptr);
+      if (keep) out->type = Node::ARR;
+      p++;
+      space();
+      if (p < end && *p == ']') { p++; depth--; return true; }
+      while (true) {
+        Node *child = nullptr;
+        if (keep && (keepAll || sub)) {
+          child = new Node;
+          out->items.push_back({"", child});
+        }
+        if (!value(child, sub)) return false;
+        space();
+        if (p >= end) return fail(DeserializationError::IncompleteInput);
+        if (*p == ',') { p++; continue; }
+        if (*p == ']') { p++; depth--; return true; }
+        return fail(DeserializationError::InvalidInput);
+      }
+    }
+    bool keep = out && keepAll;
+    if (c == '"') {
+      if (keep) out->type = Node::STR;
+      return string(keep ? &out->s : nullptr);
+    }
+    if (end - p >= 4 && !strncmp(p, "true", 4)) { p += 4; if (keep) { out->type = Node::BOOL; out->b = true; } return true; }
+    if (end - p >= 5 && !strncmp(p, "false", 5)) { p += 5; if (keep) { out->type = Node::BOOL; out->b = false; } return true; }
+    if (end - p >= 4 && !strncmp(p, "null", 4)) { p += 4; return true; }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+      const char *start = p;
+      bool real = false;
+      while (p < end && (strchr("0123456789+-", *p) || ((*p == '.' || *p == 'e' || *p == 'E') && (real = true)))) p++;
+      if (keep) {
+        std::string number(start, p - start);
+        if (real) { out->type = Node::FLOAT; out->f = strtod(number.c_str(), nullptr); }
+        else { out->type = Node::INT; out->i = strtoll(number.c_str(), nullptr, 10); }
+      }
+      return true;
+    }
+    return fail(DeserializationError::InvalidInput);
+  }
+};
+
+inline DeserializationError parse(JsonDocument &doc, const char *input, size_t length, const Node *filter) {
+  doc._root().clear();
+  Parser parser{input, input + length};
+  parser.space();
+  if (parser.p >= parser.end) return DeserializationError::EmptyInput;
+  if (!parser.value(&doc._root(), filter)) {
+    doc._root().clear();
+    return parser.error;
+  }
+  return DeserializationError::Ok;
+}
+
+inline void write(const Node *n, std::string &out) {
+  char number[32];
+  if (!n) { out += "null"; return; }
+  switch (n->type) {
+  case Node::NUL: out += "null"; break;
+  case Node::BOOL: out += n->b ? "true" : "false"; break;
+  case Node::INT: snprintf(number, sizeof(number), "%lld", n->i); out += number; break;
+  case Node::FLOAT: snprintf(number, sizeof(number), "%.15g", n->f); out += number; break;
+  case Node::RAW: out += n->s; break;
+  case Node::STR:
+    out += '"';
+    for (char c : n->s) {
+      if (c == '"' || c == '\\') { out += '\\'; out += c; }
+      else if (c == '\n') out += "\\n";
+      else if (c == '\r') out += "\\r";
+      else if (c == '\t') out += "\\t";
+      else out += c;
+    }
+    out += '"';
+    break;
+  case Node::ARR:
+  case Node::OBJ:
+    out += n->type == Node::ARR ? '[' : '{';
+    for (size_t i = 0; i < n->items.size(); i++) {
+      if (i) out += ',';
+      if (n->type == Node::OBJ) {
+        Node key;
+        key.type = Node::STR;
+        key.s = n->items[i].first;
+        write(&key, out);
+        out += ':';
+      }
+      write(n->items[i].second, out);
+    }
+    out += n->type == Node::ARR ? ']' : '}';
+    break;
+  }
+}
+}
+
+inline DeserializationError deserializeJson(JsonDocument &doc, const char *input, size_t length, DeserializationOption::Filter filter) { return mockjson::parse(doc, input, length, filter.node); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const uint8_t *input, size_t length, DeserializationOption::Filter filter) { return mockjson::parse(doc, (const char *)input, length, filter.node); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const char *input, size_t length) { return mockjson::parse(doc, input, length, nullptr); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const uint8_t *input, size_t length) { return mockjson::parse(doc, (const char *)input, length, nullptr); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const char *input) { return mockjson::parse(doc, input, strlen(input), nullptr); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const char *input, DeserializationOption::Filter filter) { return mockjson::parse(doc, input, strlen(input), filter.node); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const String &input) { return mockjson::parse(doc, input.c_str(), input.length(), nullptr); }
+inline DeserializationError deserializeJson(JsonDocument &doc, const String &input, DeserializationOption::Filter filter) { return mockjson::parse(doc, input.c_str(), input.length(), filter.node); }
+inline DeserializationError deserializeJson(JsonDocument &doc, Stream &input) { String s = input.readString(); return deserializeJson(doc, s); }
+inline DeserializationError deserializeJson(JsonDocument &doc, Stream &input, DeserializationOption::Filter filter) { String s = input.readString(); return deserializeJson(doc, s, filter); }
+
+inline size_t serializeJson(const JsonVariant &v, String &out) {
+  std::string s;
+  mockjson::write(v._node(), s);
+  out = s.c_str();
+  return s.size();
+}
+inline size_t serializeJson(const JsonVariant &v, char *out, size_t size) {
+  std::string s;
+  mockjson::write(v._node(), s);
+  if (size == 0) return 0;
+  size_t n = s.size() < size - 1 ? s.size() : size - 1;
+  memcpy(out, s.data(), n);
+  out[n] = 0;
+  return n;
+}
+inline size_t serializeJson(const JsonVariant &v, Print &out) {
+  std::string s;
+  mockjson::write(v._node(), s);
+  return out.write((const uint8_t *)s.data(), s.size());
+}
+inline size_t measureJson(const JsonVariant &v) {
+  std::string s;
+  mockjson::write(v._node(), s);
+  return s.size();
+}
@@ -0,0 +1,19 @@
+#include <Arduino.h>
+#include <WiFi.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+MockServer *mockServer = nullptr;
+
+// a clock that only delay() and the passing calls move, so runs are repeatable
+static unsigned long now = 0;
+unsigned long millis() { return now++; }
+unsigned long micros() { return now * 1000; }
+void delay(unsigned long ms) { now += ms; }
+void yield() {}
+
+long random(long high) { return high > 0 ? rand() % high : 0; }
+long random(long low, long high) { return high > low ? low + rand() % (high - low) : low; }
+void randomSeed(unsigned long seed) { srand(seed); }
+uint32_t esp_random() { return rand(); }
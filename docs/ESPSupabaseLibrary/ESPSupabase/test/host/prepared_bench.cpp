@@ -0,0 +1,100 @@
+// Prepared requests: the command poll of the firmware as doSelect() with the
+// String builder, doSelect() with SupabaseQuery and execute() of a request
+// prepared once, in heap allocations (malloc included, see heap_test), time
+// and request bytes per poll over a kept-alive connection to a mock server.
+// HTTPClient is the mock, it builds requests with Strings like the ESP32 one.
+#include "ESPSupabase.h"
+#include "SupabaseHeapCounting.h"
+#include <chrono>
+
+static const int rounds = 20000;
+static const char *answer = "[{\"id\":42,\"command\":\"STOP_SESSION\"}]";
+
+struct CommandServer : MockServer
+{
+  std::string handle(const std::string &head, const std::string &body) override
+  {
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\nContent-Length: " + std::to_string(strlen(answer)) + "\r\n\r\n" + answer;
+  }
+};
+
+static CommandServer server;
+static Supabase db;
+static String response;
+
+struct Result
+{
+  uint32_t allocations;
+  int32_t peak;
+  double us;
+  size_t requestBytes;
+};
+
+template <typename Poll>
+static Result measure(Poll poll)
+{
+  poll(); // warm up: the connection is open and url_query keeps its buffer
+
+  SupabaseHeap::reset();
+  size_t before = server.bytesIn;
+  {
+    SupabaseHeapScope scope(SupabaseHeap::REST);
+    poll();
+  }
+  const SupabaseHeapStats &s = SupabaseHeap::stats(SupabaseHeap::REST);
+  Result result = {s.allocations, s.peak, 0, server.bytesIn - before};
+
+  SupabaseHeap::end();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++)
+  {
+    poll();
+  }
+  result.us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+  SupabaseHeap::begin(true);
+  return result;
+}
+
+static void print(const char *name, const Result &r)
+{
+  printf("  %-22s %3u allocations %5d bytes peak %6.2f us %4zu bytes sent\n", name, (unsigned)r.allocations, (int)r.peak, r.us, r.requestBytes);
+}
+
+int main()
+{
+  int failures = 0;
+  mockServer = &server;
+  db.begin("https://project.supabase.co", "anon-key");
+  db.setKeepAlive(true);
+  SupabaseHeap::begin(true);
+
+  printf("device_commands poll, %u byte response\n", (unsigned)strlen(answer));
+  Result strings = measure([] {
+    db.from("device_commands").select("id,command").eq("device_id", "CO-SAFE-001").eq("executed", "false").order("created_at", "desc", true).limit(1);
+    response = db.doSelect();
+  });
+  print("doSelect()", strings);
+  failures += response != answer;
+
+  SupabaseStaticQuery<256> query;
+  query.from("device_commands").select("id,command").eq("device_id", "CO-SAFE-001").eq("executed", "false").order("created_at", "desc", true).limit(1);
+  Result fixed = measure([&query] {
+    response = db.doSelect(query);
+  });
+  print("doSelect(query)", fixed);
+  failures += response != answer;
+
+  SupabasePrepared poll = db.prepare("GET", query);
+  Result prepared = measure([&poll] {
+    db.execute(poll, "", &response);
+  });
+  print("execute(prepared)", prepared);
+  failures += response != answer;
+
+  printf("  %u connection(s) for %u requests\n", server.connects, server.requests);
+  failures += server.connects != 1;
+  failures += prepared.allocations >= strings.allocations || prepared.allocations >= fixed.allocations;
+
+  printf(failures ? "FAILED\n" : "OK\n");
+  return failures ? 1 : 0;
+}
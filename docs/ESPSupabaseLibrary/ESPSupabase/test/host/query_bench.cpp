@@ -0,0 +1,95 @@
+// Query building: the String builder of Supabase against SupabaseQuery, in
+// heap allocations (malloc included, see heap_test) and time per query
+#include "ESPSupabase.h"
+#include "SupabaseHeapCounting.h"
+#include <chrono>
+
+static const int rounds = 100000;
+static Supabase db;
+
+struct Result
+{
+  uint32_t allocations;
+  int32_t peak;
+  double ns;
+};
+
+template <typename Build>
+static Result measure(Build build)
+{
+  build(); // warm up, e.g. url_query keeps its buffer between queries
+
+  SupabaseHeap::reset();
+  {
+    SupabaseHeapScope scope(SupabaseHeap::REST);
+    build();
+  }
+  const SupabaseHeapStats &s = SupabaseHeap::stats(SupabaseHeap::REST);
+  Result result = {s.allocations, s.peak, 0};
+
+  SupabaseHeap::end();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++)
+  {
+    build();
+  }
+  result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+  SupabaseHeap::begin(true);
+  return result;
+}
+
+static void print(const char *name, const Result &r)
+{
+  printf("  %-14s %3u allocations %5d bytes peak %7.1f ns\n", name, (unsigned)r.allocations, (int)r.peak, r.ns);
+}
+
+int main()
+{
+  int failures = 0;
+  SupabaseHeap::begin(true);
+
+  // the command poll of the firmware
+  printf("device_commands poll\n");
+  Result strings = measure([] {
+    db.from("device_commands").select("id,command").eq("device_id", "CO-SAFE-001").eq("executed", "false").order("created_at", "desc", true).limit(1);
+    db.urlQuery_reset();
+  });
+  SupabaseStaticQuery<256> query;
+  Result fixed = measure([&query] {
+    query.reset();
+    query.from("device_commands").select("id,command").eq("device_id", "CO-SAFE-001").eq("executed", "false").order("created_at", "desc", true).limit(1);
+  });
+  print("String", strings);
+  print("SupabaseQuery", fixed);
+  printf("  %s\n", query.c_str());
+  failures += fixed.allocations != 0 || query.overflow();
+
+  // a range read with more filters
+  printf("co_readings range\n");
+  strings = measure([] {
+    db.from("co_readings").select("ppm,created_at,session_id").eq("device_id", "CO-SAFE-001").gte("created_at", "2024-05-01T00:00:00").lt("created_at", "2024-05-02T00:00:00").gt("ppm", "50").order("created_at", "asc", false).limit(500).offset(1000);
+    db.urlQuery_reset();
+  });
+  fixed = measure([&query] {
+    query.reset();
+    query.from("co_readings").select("ppm,created_at,session_id").eq("device_id", "CO-SAFE-001").gte("created_at", "2024-05-01T00:00:00").lt("created_at", "2024-05-02T00:00:00").gt("ppm", "50").order("created_at", "asc", false).limit(500).offset(1000);
+  });
+  print("String", strings);
+  print("SupabaseQuery", fixed);
+  printf("  %s\n", query.c_str());
+  failures += fixed.allocations != 0 || query.overflow();
+
+  // a full buffer rolls the call back and allocates nothing either
+  SupabaseStaticQuery<32> small;
+  small.from("co_readings").select("ppm").eq("device_id", "CO-SAFE-001");
+  SupabaseHeap::reset();
+  {
+    SupabaseHeapScope scope(SupabaseHeap::REST);
+    small.eq("session_id", "8d5c0f2e-6a47-4c1e-9b1a-3f0e2d7c9a55");
+  }
+  printf("overflow: %s (%s)\n", small.overflow() ? "reported" : "missed", small.c_str());
+  failures += !small.overflow() || SupabaseHeap::stats(SupabaseHeap::REST).allocations != 0;
+
+  printf(failures ? "FAILED\n" : "OK\n");
+  return failures ? 1 : 0;
+}
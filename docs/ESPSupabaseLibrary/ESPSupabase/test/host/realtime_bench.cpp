@@ -0,0 +1,103 @@
+// Realtime dispatch: frames per second and heap allocations per frame of a
+// postgres_changes INSERT, parsed once through the event filter into the
+// typed handler, against the String handler given to begin()
+#include "ESPSupabaseRealtime.h"
+#include "SupabaseHeapCounting.h"
+#include <chrono>
+
+static const int frames = 20000;
+static const char *joinReply = "{\"topic\":\"realtime:*\",\"event\":\"phx_reply\",\"ref\":\"%s\",\"payload\":{\"status\":\"ok\",\"response\":{\"postgres_changes\":[{\"id\":31339675,\"event\":\"INSERT\",\"schema\":\"public\",\"table\":\"co_readings\",\"filter\":\"device_id=eq.CO-SAFE-001\"}]}}}";
+
+// what Supabase Realtime sends for one new co_readings row
+static const char *insert =
+    "{\"event\":\"postgres_changes\",\"payload\":{\"data\":{"
+    "\"columns\":[{\"name\":\"id\",\"type\":\"int8\"},{\"name\":\"session_id\",\"type\":\"uuid\"},{\"name\":\"device_id\",\"type\":\"text\"},"
+    "{\"name\":\"co_level\",\"type\":\"float8\"},{\"name\":\"status\",\"type\":\"text\"},{\"name\":\"created_at\",\"type\":\"timestamptz\"},"
+    "{\"name\":\"mosfet_status\",\"type\":\"bool\"}],"
+    "\"commit_timestamp\":\"2024-05-01T10:15:42.318Z\",\"errors\":null,"
+    "\"record\":{\"co_level\":37.5,\"created_at\":\"2024-05-01T10:15:42.301+00:00\",\"device_id\":\"CO-SAFE-001\",\"id\":120345,"
+    "\"mosfet_status\":true,\"session_id\":\"8d5c0f2e-6a47-4c1e-9b1a-3f0e2d7c9a55\",\"status\":\"critical\"},"
+    "\"schema\":\"public\",\"table\":\"co_readings\",\"type\":\"INSERT\"},\"ids\":[31339675]},"
+    "\"ref\":null,\"topic\":\"realtime:*\"}";
+
+static int changes = 0;
+static double lastLevel = 0;
+static int texts = 0;
+static size_t textLength = 0;
+
+static void onText(String data)
+{
+  texts++;
+  textLength = data.length();
+}
+
+struct Result
+{
+  uint32_t allocations;
+  int32_t peak;
+  double perSecond;
+};
+
+// joins realtime:* and plays the INSERT frames to it
+static Result run(SupabaseRealtime &realtime)
+{
+  realtime.addChangesListener("co_readings", "INSERT", "public", "device_id=eq.CO-SAFE-001");
+  realtime.listen();
+  WebSocketsClient *socket = WebSocketsClient::last;
+  socket->receive(WStype_CONNECTED, "");
+
+  JsonDocument join;
+  deserializeJson(join, socket->sent.back().c_str());
+  char reply[400];
+  snprintf(reply, sizeof(reply), joinReply, join["ref"].as<const char *>());
+  socket->receive(WStype_TEXT, reply);
+  socket->receive(WStype_TEXT, insert); // warm up
+
+  SupabaseHeap::reset();
+  socket->receive(WStype_TEXT, insert);
+  const SupabaseHeapStats &s = SupabaseHeap::stats(SupabaseHeap::REALTIME);
+  Result result = {s.allocations, s.peak, 0};
+
+  SupabaseHeap::end();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < frames; i++)
+  {
+    socket->receive(WStype_TEXT, insert);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.perSecond = frames / seconds;
+  SupabaseHeap::begin(true);
+  return result;
+}
+
+static void print(const char *name, const Result &r)
+{
+  printf("  %-16s %3u allocations %6d bytes peak %9.0f frames/s\n", name, (unsigned)r.allocations, (int)r.peak, r.perSecond);
+}
+
+int main()
+{
+  int failures = 0;
+  SupabaseHeap::begin(true);
+  printf("co_readings INSERT, %u byte frame\n", (unsigned)strlen(insert));
+
+  static SupabaseRealtime typed;
+  typed.begin("https://project.supabase.co", "anon-key", nullptr);
+  typed.onChange([](const SupabaseChange &change) {
+    changes++;
+    lastLevel = change.record["co_level"].as<double>();
+  });
+  Result filtered = run(typed);
+  print("onChange", filtered);
+  failures += changes != frames + 2 || lastLevel != 37.5;
+
+  static SupabaseRealtime legacy;
+  legacy.begin("https://project.supabase.co", "anon-key", onText);
+  Result text = run(legacy);
+  print("String handler", text);
+  printf("  (%u byte String per change)\n", (unsigned)textLength);
+  failures += texts != frames + 2;
+
+  printf(failures ? "FAILED\n" : "OK\n");
+  return failures ? 1 : 0;
+}
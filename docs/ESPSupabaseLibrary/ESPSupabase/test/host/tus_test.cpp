@@ -0,0 +1,436 @@
+// Resumable uploads against a TUS stand-in: create, PATCH progress, HEAD
+// resume after a dropped connection, 409 offset mismatch, 404/410 restart,
+// resume from the state file, and uploads on a kept-alive connection the
+// server already closed
+#include "ESPSupabase.h"
+#include <FS.h>
+#include <map>
+
+static int failures = 0;
+#define CHECK(cond)                                              \
+  do                                                             \
+  {                                                              \
+    if (!(cond))                                                 \
+    {                                                            \
+      printf("  FAIL %s:%d %s\n", __FILE__, __LINE__, #cond);    \
+      failures++;                                                \
+    }                                                            \
+  } while (0)
+
+static const std::string tusPath = "/storage/v1/upload/resumable";
+
+// Keeps uploads in memory like Supabase Storage does. log lists the requests
+// it saw with their status, e.g. "POST 201 PATCH 204 "
+struct TusServer : MockServer
+{
+  struct Upload
+  {
+    std::string data;
+    size_t length = 0;
+    bool expired = false;
+  };
+  std::map<std::string, Upload> uploads;
+  int created = 0;
+  int conflicts = 0;          // PATCHes still to answer with 409
+  bool expireOnPatch = false; // every upload expires on its first PATCH
+  bool downAfterBreak = false;
+  std::string log;
+
+  static std::string header(const std::string &head, const std::string &name)
+  {
+    size_t p = head.find("\r\n" + name + ": ");
+    if (p == std::string::npos)
+    {
+      return "";
+    }
+    p += name.size() + 4;
+    return head.substr(p, head.find("\r\n", p) - p);
+  }
+
+  static void request(const std::string &head, std::string &method, std::string &path)
+  {
+    size_t a = head.find(' ');
+    method = head.substr(0, a);
+    path = head.substr(a + 1, head.find(' ', a + 1) - a - 1);
+  }
+
+  std::string status(const char *code, const std::string &headers = "", const std::string &body = "")
+  {
+    log += std::string(code, 3) + " ";
+    return std::string("HTTP/1.1 ") + code + "\r\nTus-Resumable: 1.0.0\r\n" + headers + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  }
+
+  std::string handle(const std::string &head, const std::string &body) override
+  {
+    std::string method, path;
+    request(head, method, path);
+    log += method + " ";
+    if (header(head, "Tus-Resumable") != "1.0.0")
+    {
+      return status("412 Precondition Failed");
+    }
+
+    if (method == "POST" && path == tusPath)
+    {
+      std::string id = tusPath + "/" + std::to_string(++created);
+      uploads[id].length = strtoul(header(head, "Upload-Length").c_str(), nullptr, 10);
+      return status("201 Created", "Location: https://project.supabase.co" + id + "\r\n");
+    }
+
+    auto found = uploads.find(path);
+    if (found == uploads.end())
+    {
+      return status("404 Not Found", "", "Upload not found");
+    }
+    Upload &upload = found->second;
+    if (method == "PATCH" && expireOnPatch)
+    {
+      upload.expired = true;
+    }
+    if (upload.expired)
+    {
+      return status("410 Gone", "", "Upload expired");
+    }
+
+    std::string offset = "Upload-Offset: " + std::to_string(upload.data.size()) + "\r\n";
+    if (method == "HEAD")
+    {
+      return status("200 OK", offset + "Upload-Length: " + std::to_string(upload.length) + "\r\nCache-Control: no-store\r\n");
+    }
+    if (method == "PATCH")
+    {
+      if (conflicts > 0 || strtoul(header(head, "Upload-Offset").c_str(), nullptr, 10) != upload.data.size())
+      {
+        conflicts -= conflicts > 0;
+        return status("409 Conflict", "", "Offset mismatch");
+      }
+      upload.data += body;
+      return status("204 No Content", "Upload-Offset: " + std::to_string(upload.data.size()) + "\r\n");
+    }
+    return status("405 Method Not Allowed");
+  }
+
+  // what arrived of a broken PATCH is kept, as a TUS server does
+  void interrupted(const std::string &head, const std::string &body) override
+  {
+    std::string method, path;
+    request(head, method, path);
+    log += method + " broken ";
+    auto found = uploads.find(path);
+    if (method == "PATCH" && found != uploads.end() && strtoul(header(head, "Upload-Offset").c_str(), nullptr, 10) == found->second.data.size())
+    {
+      found->second.data += body;
+    }
+    refuse = downAfterBreak;
+  }
+
+  const std::string &data(int id)
+  {
+    return uploads[tusPath + "/" + std::to_string(id)].data;
+  }
+};
+
+static std::string content(size_t size)
+{
+  std::string s;
+  for (size_t i = 0; i < size; i++)
+  {
+    s += (char)('a' + (i * 7 + i / 13) % 26);
+  }
+  return s;
+}
+
+static Supabase db;
+static SupabaseRetryPolicy retry(4, 100, 1000, 100, 60000);
+static const char *statePath = "/supabase-upload.tus";
+
+// a fresh server, file system and client for each case
+static void setup(MockServer &server, FS &fs, const std::string &data)
+{
+  mockServer = &server;
+  db.disconnect();
+  File file = fs.open("/log.txt", "w");
+  file.write((const uint8_t *)data.data(), data.size());
+  file.close();
+}
+
+static void createAndProgress()
+{
+  printf("create and PATCH progress\n");
+  TusServer server;
+  FS fs;
+  std::string data = content(10000);
+  setup(server, fs, data);
+
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log == "POST 201 PATCH 204 PATCH 204 PATCH 204 ");
+  CHECK(server.data(1) == data);
+  CHECK(!fs.exists(statePath));
+  CHECK(db.getUploadStats().bytes > 10000);
+}
+
+static void keepAliveConnection()
+{
+  printf("one connection with keep-alive\n");
+  TusServer server;
+  FS fs;
+  std::string data = content(10000);
+  setup(server, fs, data);
+
+  db.setKeepAlive(true);
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  db.setKeepAlive(false);
+  CHECK(code == 204);
+  CHECK(server.data(1) == data);
+  CHECK(server.connects == 1);
+}
+
+static void resumeAfterDrop()
+{
+  printf("HEAD resume after a dropped connection\n");
+  TusServer server;
+  FS fs;
+  std::string data = content(10000);
+  setup(server, fs, data);
+
+  // breaks in the middle of the second PATCH body
+  server.breakAfter = 6000;
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log.find("PATCH broken HEAD 200 PATCH 204") != std::string::npos);
+  CHECK(server.created == 1);
+  CHECK(server.data(1) == data);
+  CHECK(!fs.exists(statePath));
+}
+
+static void offsetMismatch()
+{
+  printf("409 offset mismatch\n");
+  TusServer server;
+  FS fs;
+  std::string data = content(10000);
+  setup(server, fs, data);
+
+  server.conflicts = 1;
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log == "POST 201 PATCH 409 HEAD 200 PATCH 204 PATCH 204 PATCH 204 ");
+  CHECK(server.data(1) == data);
+}
+
+static void expiredRestart()
+{
+  printf("404 and 410 restart\n");
+  std::string data = content(10000);
+  for (bool gone : {false, true})
+  {
+    TusServer server;
+    FS fs;
+    setup(server, fs, data);
+
+    // a state file left by an earlier run, the server forgot (404) or expired (410) it
+    server.created = 7;
+    if (gone)
+    {
+      server.uploads[tusPath + "/7"].length = data.size();
+      server.uploads[tusPath + "/7"].expired = true;
+    }
+    File state = fs.open(statePath, "w");
+    state.print("logs/log.txt 10000\n" + String(tusPath.c_str()) + "/7\n");
+    state.close();
+
+    File file = fs.open("/log.txt");
+    int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+    CHECK(code == 204);
+    CHECK(server.log == std::string("HEAD ") + (gone ? "410" : "404") + " POST 201 PATCH 204 PATCH 204 PATCH 204 ");
+    CHECK(server.data(8) == data);
+    CHECK(!fs.exists(statePath));
+  }
+
+  // an upload that keeps expiring gives up after the attempts of the retry policy
+  TusServer server;
+  FS fs;
+  setup(server, fs, data);
+  server.expireOnPatch = true;
+  db.setRetryPolicy(&retry);
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  db.setRetryPolicy(nullptr);
+  CHECK(code == 410);
+  CHECK(server.created == 4);
+  CHECK(!fs.exists(statePath));
+}
+
+static void resumeFromStateFile()
+{
+  printf("resume from the state file\n");
+  TusServer server;
+  FS fs;
+  std::string data = content(10000);
+  setup(server, fs, data);
+
+  // the server goes away in the middle of the second PATCH, the retries give up
+  server.breakAfter = 6000;
+  server.downAfterBreak = true;
+  db.setRetryPolicy(&retry);
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  db.setRetryPolicy(nullptr);
+  CHECK(code == HTTPC_ERROR_CONNECTION_REFUSED);
+  CHECK(fs.exists(statePath));
+  File state = fs.open(statePath);
+  CHECK(state.readStringUntil('\n') == "logs/log.txt 10000");
+  CHECK(state.readStringUntil('\n') == (tusPath + "/1").c_str());
+  state.close();
+  size_t kept = server.data(1).size();
+  CHECK(kept > 4096 && kept < 10000);
+
+  // after a reboot it continues where the server is, without a new create
+  server.refuse = false;
+  server.log = "";
+  file = fs.open("/log.txt");
+  code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log == "HEAD 200 PATCH 204 PATCH 204 ");
+  CHECK(server.created == 1);
+  CHECK(server.data(1) == data);
+  CHECK(!fs.exists(statePath));
+
+  // a state file of another file is ignored
+  state = fs.open(statePath, "w");
+  state.print("logs/other.txt 10000\n" + String(tusPath.c_str()) + "/1\n");
+  state.close();
+  server.log = "";
+  file = fs.open("/log.txt");
+  code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log.rfind("POST 201 ", 0) == 0);
+  CHECK(server.data(2) == data);
+}
+
+// answers upload() the way Storage does, body is the last multipart body
+struct StorageServer : MockServer
+{
+  std::string body;
+
+  std::string handle(const std::string &head, const std::string &body_a) override
+  {
+    body = body_a;
+    const char *answer = "{\"Key\":\"logs/log.txt\"}";
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(strlen(answer)) + "\r\n\r\n" + answer;
+  }
+};
+
+static void staleConnection()
+{
+  printf("kept-alive connection closed by the server\n");
+  std::string data = content(10000);
+  db.setKeepAlive(true);
+
+  // the second PATCH finds the connection closed, once unanswered and once
+  // failing to write, and is sent again on a new one
+  for (bool reset : {false, true})
+  {
+    TusServer server;
+    FS fs;
+    setup(server, fs, data);
+    server.staleAt = 3;
+    server.staleReset = reset;
+    uint32_t reconnects = db.getConnectionStats().reconnects;
+    File file = fs.open("/log.txt");
+    int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+    CHECK(code == 204);
+    CHECK(server.log == "POST 201 PATCH 204 PATCH 204 PATCH 204 ");
+    CHECK(server.data(1) == data);
+    CHECK(server.connects == 2);
+    CHECK(db.getConnectionStats().reconnects == reconnects + 1);
+  }
+
+  // the HEAD after a 409 too
+  TusServer server;
+  FS fs;
+  setup(server, fs, data);
+  server.conflicts = 1;
+  server.staleAt = 3;
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log == "POST 201 PATCH 409 HEAD 200 PATCH 204 PATCH 204 PATCH 204 ");
+  CHECK(server.data(1) == data);
+  CHECK(server.connects == 2);
+
+  // upload() from RAM and from a stream, whose preamble goes first so the
+  // stream is only read on a connection that took it
+  for (bool fromStream : {false, true})
+  {
+    StorageServer storage;
+    FS fs;
+    setup(storage, fs, data);
+    CHECK(db.upload("logs", "first.txt", "text/plain", (uint8_t *)"first", 5) == 200);
+    storage.staleAt = 2;
+    storage.staleReset = fromStream;
+    uint32_t reconnects = db.getConnectionStats().reconnects;
+    int code;
+    if (fromStream)
+    {
+      File file = fs.open("/log.txt");
+      code = db.upload("logs", "log.txt", "text/plain", &file, data.size());
+    }
+    else
+    {
+      code = db.upload("logs", "log.txt", "text/plain", (uint8_t *)data.data(), data.size());
+    }
+    CHECK(code == 200);
+    CHECK(storage.body.find(data) != std::string::npos);
+    CHECK(storage.connects == 2);
+    CHECK(db.getConnectionStats().reconnects == reconnects + 1);
+  }
+
+  // a stream already read is not sent twice
+  StorageServer storage;
+  setup(storage, fs, data);
+  CHECK(db.upload("logs", "first.txt", "text/plain", (uint8_t *)"first", 5) == 200);
+  storage.staleAt = 2;
+  file = fs.open("/log.txt");
+  code = db.upload("logs", "log.txt", "text/plain", &file, data.size());
+  CHECK(code == HTTPC_ERROR_CONNECTION_LOST);
+  CHECK(storage.requests == 1);
+  db.setKeepAlive(false);
+}
+
+static void emptyFile()
+{
+  printf("empty file\n");
+  TusServer server;
+  FS fs;
+  setup(server, fs, "");
+
+  File file = fs.open("/log.txt");
+  int code = db.uploadResumable("logs", "log.txt", "text/plain", file, fs);
+  CHECK(code == 204);
+  CHECK(server.log == "POST 201 ");
+  CHECK(!fs.exists(statePath));
+}
+
+int main()
+{
+  db.begin("https://project.supabase.co", "anon-key");
+  db.setResumableChunk(4096);
+
+  createAndProgress();
+  keepAliveConnection();
+  resumeAfterDrop();
+  offsetMismatch();
+  expiredRestart();
+  resumeFromStateFile();
+  staleConnection();
+  emptyFile();
+
+  printf(failures ? "%d FAILED\n" : "OK\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+// Inserts with Prefer: return=representation (what insert() used to ask
+// for) against return=minimal and headers-only, in response bytes, request
+// bytes, heap allocations and time per insert, for one reading and for a
+// bulk insert of 20 over a kept-alive connection to a PostgREST stand-in
+#include "ESPSupabase.h"
+#include "SupabaseHeapCounting.h"
+#include <chrono>
+
+static const int rounds = 5000;
+
+// answers inserts the way PostgREST does behind the Supabase gateway
+struct PostgrestServer : MockServer
+{
+  unsigned rows = 0;
+
+  std::string handle(const std::string &head, const std::string &body) override
+  {
+    std::string common = "Date: Wed, 01 May 2024 10:15:42 GMT\r\nConnection: keep-alive\r\nServer: cloudflare\r\n"
+                         "CF-Ray: 87d2a1b5cf3e4a12-SIN\r\nsb-gateway-version: 1\r\nContent-Range: */*\r\n";
+    // the rows of the payload, each with the columns the database fills in
+    std::string inserted = "[";
+    size_t start = 0;
+    unsigned count = 0;
+    while ((start = body.find('{', start)) != std::string::npos)
+    {
+      size_t end = body.find('}', start);
+      if (count++)
+      {
+        inserted += ",";
+      }
+      inserted += "{\"id\":" + std::to_string(120345 + rows++) + ",\"session_id\":\"8d5c0f2e-6a47-4c1e-9b1a-3f0e2d7c9a55\",\"created_at\":\"2024-05-01T10:15:42.301+00:00\"," + body.substr(start + 1, end - start);
+      start = end;
+    }
+    inserted += "]";
+
+    if (head.find("return=representation") != std::string::npos)
+    {
+      return "HTTP/1.1 201 Created\r\n" + common + "Content-Type: application/json; charset=utf-8\r\nContent-Length: " + std::to_string(inserted.size()) + "\r\n\r\n" + inserted;
+    }
+    if (head.find("return=headers-only") != std::string::npos)
+    {
+      return "HTTP/1.1 201 Created\r\n" + common + "Location: /co_readings?id=eq." + std::to_string(120345 + rows) + "\r\nContent-Length: 0\r\n\r\n";
+    }
+    return "HTTP/1.1 201 Created\r\n" + common + "Content-Length: 0\r\n\r\n";
+  }
+};
+
+static PostgrestServer server;
+static Supabase db;
+
+struct Result
+{
+  uint32_t allocations;
+  double us;
+  size_t requestBytes;
+  size_t responseBytes;
+  int httpCode;
+};
+
+static Result measure(const String &json, SupabaseWriteOptions::Return mode)
+{
+  SupabaseWriteOptions options = SupabaseWriteOptions().returning(mode);
+  db.insert("co_readings", json, options); // warm up
+
+  Result result;
+  SupabaseHeap::reset();
+  size_t in = server.bytesIn, out = server.bytesOut;
+  {
+    SupabaseHeapScope scope(SupabaseHeap::REST);
+    result.httpCode = db.insert("co_readings", json, options);
+  }
+  result.allocations = SupabaseHeap::stats(SupabaseHeap::REST).allocations;
+  result.requestBytes = server.bytesIn - in;
+  result.responseBytes = server.bytesOut - out;
+
+  SupabaseHeap::end();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++)
+  {
+    db.insert("co_readings", json, options);
+  }
+  result.us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+  SupabaseHeap::begin(true);
+  return result;
+}
+
+static void print(const char *name, const Result &r)
+{
+  printf("  %-16s %5zu bytes back %5zu bytes sent %3u allocations %6.2f us\n", name, r.responseBytes, r.requestBytes, (unsigned)r.allocations, r.us);
+}
+
+static int compare(const char *title, const String &json)
+{
+  printf("%s\n", title);
+  Result representation = measure(json, SupabaseWriteOptions::REPRESENTATION);
+  Result headers = measure(json, SupabaseWriteOptions::HEADERS_ONLY);
+  Result minimal = measure(json, SupabaseWriteOptions::MINIMAL);
+  print("representation", representation);
+  print("headers-only", headers);
+  print("minimal", minimal);
+  printf("  minimal saves %.0f%% of the response bytes\n", 100.0 * (representation.responseBytes - minimal.responseBytes) / representation.responseBytes);
+
+  int failures = 0;
+  failures += representation.httpCode != 201 || headers.httpCode != 201 || minimal.httpCode != 201;
+  failures += minimal.responseBytes >= headers.responseBytes || headers.responseBytes >= representation.responseBytes;
+  return failures;
+}
+
+int main()
+{
+  int failures = 0;
+  mockServer = &server;
+  db.begin("https://project.supabase.co", "anon-key");
+  db.setKeepAlive(true);
+  SupabaseHeap::begin(true);
+
+  String reading = "{\"device_id\":\"CO-SAFE-001\",\"co_level\":37.5,\"status\":\"critical\",\"mosfet_status\":true}";
+  failures += compare("one co_readings row", reading);
+
+  String bulk = "[";
+  for (int i = 0; i < 20; i++)
+  {
+    bulk += i ? "," : "";
+    bulk += reading;
+  }
+  bulk += "]";
+  failures += compare("bulk insert of 20 rows", bulk);
+
+  printf("  %u connection(s) for %u requests\n", server.connects, server.requests);
+  failures += server.connects != 1;
+
+  printf(failures ? "FAILED\n" : "OK\n");
+  return failures ? 1 : 0;
+}
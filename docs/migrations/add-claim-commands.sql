@@ -0,0 +1,73 @@
+-- Migration: Add claim_commands RPC function
+-- Created: 2025-01-13
+-- Description: Atomically marks up to p_limit pending commands of a device as executed and
+-- returns them (UPDATE ... RETURNING), replacing the fetch + PATCH per command round trips.
+-- ingest_readings now claims the commands it returns as well.
+
+CREATE OR REPLACE FUNCTION claim_commands(p_device_id TEXT, p_limit INTEGER DEFAULT 10)
+RETURNS TABLE (
+    id BIGINT,
+    command TEXT
+) AS $$
+BEGIN
+    -- SKIP LOCKED: two callers with the same device id never claim the same command
+    RETURN QUERY
+    WITH claimed AS (
+        UPDATE device_commands dc
+        SET executed = TRUE,
+            executed_at = NOW()
+        WHERE dc.id IN (
+            SELECT pending.id
+            FROM device_commands pending
+            WHERE pending.device_id = p_device_id
+              AND pending.executed = FALSE
+            ORDER BY pending.created_at
+            LIMIT p_limit
+            FOR UPDATE SKIP LOCKED
+        )
+          AND dc.executed = FALSE
+        RETURNING dc.id, dc.command, dc.created_at
+    )
+    SELECT claimed.id, claimed.command
+    FROM claimed
+    ORDER BY claimed.created_at;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Same signature as in add-ingest-readings.sql, the pending commands are now claimed
+CREATE OR REPLACE FUNCTION ingest_readings(p_device_id TEXT, p_readings JSONB)
+RETURNS TABLE (
+    id BIGINT,
+    command TEXT
+) AS $$
+BEGIN
+    -- p_readings is a single reading object or an array of them
+    INSERT INTO co_readings (session_id, device_id, co_level, status, mosfet_status, created_at)
+    SELECT
+        r.session_id,
+        p_device_id,
+        r.co_level,
+        r.status,
+        COALESCE(r.mosfet_status, FALSE),
+        COALESCE(r.created_at, NOW())
+    FROM jsonb_to_recordset(
+        CASE jsonb_typeof(p_readings)
+            WHEN 'array' THEN p_readings
+            ELSE jsonb_build_array(p_readings)
+        END
+    ) AS r(session_id UUID, co_level FLOAT, status TEXT, mosfet_status BOOLEAN, created_at TIMESTAMPTZ);
+
+    RETURN QUERY
+    SELECT c.id, c.command FROM claim_commands(p_device_id) c;
+END;
+$$ LANGUAGE plpgsql;
+
+-- ============================================
+-- MIGRATION COMPLETE
+-- ============================================
+
+-- Usage Notes:
+-- - POST /rest/v1/rpc/claim_commands with {"p_device_id": "...", "p_limit": 5}
+-- - Returns [{"id": 1, "command": "START_SESSION:..."}, ...] oldest first, [] when nothing is pending
+-- - Commands are marked executed when they are handed out (at most once delivery),
+--   the device no longer PATCHes device_commands
@@ -0,0 +1,48 @@
+-- Migration: Add ingest_readings RPC function
+-- Created: 2025-01-12
+-- Description: Inserts one reading or a batch of readings and returns the pending commands
+-- for the device in the same response, so a monitoring device doesn't have to poll
+-- device_commands separately
+
+CREATE OR REPLACE FUNCTION ingest_readings(p_device_id TEXT, p_readings JSONB)
+RETURNS TABLE (
+    id BIGINT,
+    command TEXT
+) AS $$
+BEGIN
+    -- p_readings is a single reading object or an array of them
+    INSERT INTO co_readings (session_id, device_id, co_level, status, mosfet_status, created_at)
+    SELECT
+        r.session_id,
+        p_device_id,
+        r.co_level,
+        r.status,
+        COALESCE(r.mosfet_status, FALSE),
+        COALESCE(r.created_at, NOW())
+    FROM jsonb_to_recordset(
+        CASE jsonb_typeof(p_readings)
+            WHEN 'array' THEN p_readings
+            ELSE jsonb_build_array(p_readings)
+        END
+    ) AS r(session_id UUID, co_level FLOAT, status TEXT, mosfet_status BOOLEAN, created_at TIMESTAMPTZ);
+
+    -- Pending commands, oldest first
+    RETURN QUERY
+    SELECT dc.id, dc.command
+    FROM device_commands dc
+    WHERE dc.device_id = p_device_id
+      AND dc.executed = FALSE
+    ORDER BY dc.created_at;
+END;
+$$ LANGUAGE plpgsql;
+
+-- ============================================
+-- MIGRATION COMPLETE
+-- ============================================
+
+-- Usage Notes:
+-- - POST /rest/v1/rpc/ingest_readings with {"p_device_id": "...", "p_readings": {...} or [...]}
+-- - Reading fields: session_id, co_level, status, mosfet_status, created_at (optional, defaults to NOW())
+-- - Returns [{"id": 1, "command": "STOP_SESSION"}, ...], [] when nothing is pending
+-- - Commands are not marked executed here, the device acknowledges them after running them
+-- - Served by idx_commands_device_pending